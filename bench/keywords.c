@@ -0,0 +1,132 @@
+// Copyright (C) 2021 Ramsay Carslaw
+/* Times keyword lookup on the test/ samples, the linear scan the
+ * highlighter used to do against the compiled trie it does now, and
+ * checks the two agree at every position.
+ *
+ *   make bench
+ */
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/keywords.h"
+#include "../include/syntax.h"
+
+#define REPEAT 200
+
+void die(const char *s) {
+  perror(s);
+  exit(1);
+}
+
+/* The old lookup, kept here to compare against */
+static int linearMatch(char **keywords, const char *s, int *len) {
+  for (int j = 0; keywords[j]; j++) {
+    int klen = strlen(keywords[j]);
+    int kw2 = keywords[j][klen - 1] == '|';
+    if (kw2)
+      klen--;
+    if (!strncmp(s, keywords[j], klen) && is_separator(s[klen])) {
+      *len = klen;
+      return kw2 ? HL_KEYWORD2 : HL_KEYWORD1;
+    }
+  }
+  return 0;
+}
+
+static struct editorSyntax *syntaxFor(const char *filename) {
+  char *ext = strrchr(filename, '.');
+  for (unsigned int j = 0; j < HLDB_ENTRIES; j++)
+    for (unsigned int i = 0; HLDB[j].filematch[i]; i++) {
+      char *m = HLDB[j].filematch[i];
+      if ((m[0] == '.' && ext && !strcmp(ext, m)) ||
+          (m[0] != '.' && strstr(filename, m)))
+        return &HLDB[j];
+    }
+  return NULL;
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *readAll(const char *path, long *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  rewind(f);
+  char *buf = malloc(n + 1);
+  if (fread(buf, 1, n, f) != (size_t)n)
+    n = 0;
+  buf[n] = '\0';
+  fclose(f);
+  *len = n;
+  return buf;
+}
+
+int main(int argc, char *argv[]) {
+  int failed = 0;
+
+  printf("%-16s %-9s %9s %12s %12s %8s\n", "file", "syntax", "positions",
+         "linear ns", "trie ns", "speedup");
+  for (int a = 1; a < argc; a++) {
+    struct editorSyntax *syn = syntaxFor(argv[a]);
+    long len = 0;
+    char *text = readAll(argv[a], &len);
+    if (syn == NULL || text == NULL || len == 0) {
+      free(text);
+      continue;
+    }
+    struct kwTrie *trie = editorKeywordsCompile(syn->keywords);
+
+    /* every position a keyword could start at, lines end at their NUL */
+    for (long i = 0; i < len; i++)
+      if (text[i] == '\n')
+        text[i] = '\0';
+    int *pos = malloc(sizeof(int) * len);
+    int npos = 0;
+    for (long i = 0; i < len; i++)
+      if (text[i] && (i == 0 || is_separator(text[i - 1])))
+        pos[npos++] = i;
+
+    for (int k = 0; k < npos; k++) {
+      int l1 = 0, l2 = 0;
+      int h1 = linearMatch(syn->keywords, &text[pos[k]], &l1);
+      int h2 = editorKeywordMatch(trie, &text[pos[k]], len - pos[k], &l2);
+      if (h1 != h2 || (h1 && l1 != l2)) {
+        printf("%s: mismatch at byte %d\n", argv[a], pos[k]);
+        failed = 1;
+      }
+    }
+
+    volatile int sink = 0;
+    int l;
+    double t0 = now();
+    for (int r = 0; r < REPEAT; r++)
+      for (int k = 0; k < npos; k++)
+        sink += linearMatch(syn->keywords, &text[pos[k]], &l);
+    double t1 = now();
+    for (int r = 0; r < REPEAT; r++)
+      for (int k = 0; k < npos; k++)
+        sink += editorKeywordMatch(trie, &text[pos[k]], len - pos[k], &l);
+    double t2 = now();
+
+    double lin = (t1 - t0) * 1e9 / ((double)REPEAT * npos);
+    double tri = (t2 - t1) * 1e9 / ((double)REPEAT * npos);
+    const char *name = strrchr(argv[a], '/') ? strrchr(argv[a], '/') + 1
+                                             : argv[a];
+    printf("%-16s %-9s %9d %12.1f %12.1f %7.1fx\n", name, syn->filetype, npos,
+           lin, tri, lin / tri);
+    free(pos);
+    free(text);
+  }
+  return failed;
+}
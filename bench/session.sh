@@ -0,0 +1,138 @@
+#!/bin/sh
+# Copyright (C) 2021 Ramsay Carslaw
+# Times whole editing sessions by replaying keys through charm --headless
+# on generated files: a large C file, a single line of JSON, C with long
+# runs of comments and tab indented Go, the C and Go modeled on test/. Each
+# file is opened, scrolled, searched, edited and saved in separate runs so
+# every phase is timed on its own, and the results are written to stdout
+# as JSON.
+#
+#   make bench
+#   CHARM=./old-charm LINES=100000 JSON_MB=5 ./bench/session.sh
+set -e
+
+CHARM=${CHARM:-./charm}
+LINES=${LINES:-1000000}
+JSON_MB=${JSON_MB:-50}
+SIZE=${SIZE:-200x60}
+TEST=$(dirname "$0")/../test
+
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/charm-bench.XXXXXX")
+trap 'rm -rf "$DIR"' EXIT
+
+# charm needs an init file, time it with one of ours rather than the user's
+export HOME="$DIR"
+cat > "$DIR/.charm.mt" <<'EOF'
+// the classic theme
+var vim = 1;
+var commentColor = 4;
+var normalColor = 7;
+var backgroundColor = 234;
+EOF
+
+# the rare word searched for, once three quarters of the way in
+NEEDLE=zqxneedle
+
+# test/test.c over and over
+awk -v n="$LINES" -v needle="$NEEDLE" '
+  { l[NR] = $0 }
+  END {
+    for (i = 0; i < n; i++) {
+      if (i == int(n * 3 / 4))
+        print "int " needle " = 0;"
+      print l[i % NR + 1]
+    }
+  }' "$TEST/test.c" > "$DIR/big.c"
+
+# one line of objects
+awk -v mb="$JSON_MB" -v needle="$NEEDLE" '
+  BEGIN {
+    want = mb * 1024 * 1024
+    printf "["
+    for (i = 0; len < want; i++) {
+      s = sprintf("%s{\"id\": %d, \"name\": \"item%d\", \"tags\": [\"a\", \"b\"], \"value\": %d.5}",
+                  i ? ", " : "", i, i, i)
+      if (len < want * 3 / 4 && len + length(s) >= want * 3 / 4)
+        s = s ", \"" needle "\""
+      printf "%s", s
+      len += length(s)
+    }
+    print "]"
+  }' > "$DIR/one.json"
+
+# comments opened a level deeper on every line and closed every thousand,
+# so an edit near the top changes the state of the lines after it
+awk -v n="$LINES" -v needle="$NEEDLE" '
+  BEGIN {
+    for (i = 1; i <= n; i++) {
+      if (i == int(n * 3 / 4))
+        print "int " needle ";"
+      if (i % 1000 == 0) {
+        print "*/ int x" i " = " i "; /* " i
+      } else {
+        s = ""
+        for (j = 0; j < i % 16; j++)
+          s = s "/* "
+        print s "nested " i
+      }
+    }
+    print "*/"
+  }' > "$DIR/nest.c"
+
+# test/test.go with its bodies indented deeper and deeper by tabs
+awk -v n="$LINES" -v needle="$NEEDLE" '
+  { l[NR] = $0 }
+  END {
+    print l[1]
+    for (i = 0; i < n; i++) {
+      if (i == int(n * 3 / 4))
+        print "var " needle " = 0"
+      s = l[i % (NR - 1) + 2]
+      for (j = 0; j < i % 8; j++)
+        s = "\t" s
+      print s
+    }
+  }' "$TEST/test.go" > "$DIR/tabs.go"
+
+# the keys for each phase
+printf '' > "$DIR/open.keys"
+# the page keys only move in insert mode
+awk 'BEGIN { printf "Gggi"
+             for (i = 0; i < 500; i++) printf "\033[6~"
+             for (i = 0; i < 500; i++) printf "\033[5~"
+             printf "\033" }' > "$DIR/scroll.keys"
+awk -v needle="$NEEDLE" 'BEGIN { for (i = 0; i < 5; i++) printf "/" needle "\r" }' > "$DIR/search.keys"
+awk 'BEGIN {
+       for (i = 0; i < 100; i++) printf "jo/* added line %d */\033", i
+       for (i = 0; i < 200; i++) printf "x"
+       for (i = 0; i < 200; i++) printf "dd"
+     }' > "$DIR/edit.keys"
+printf 'x:w\r' > "$DIR/save.keys"
+
+echo "{"
+echo "  \"charm\": \"$CHARM\", \"lines\": $LINES, \"json_mb\": $JSON_MB, \"size\": \"$SIZE\","
+echo "  \"files\": {"
+sep=""
+for file in big.c one.json nest.c tabs.go; do
+  printf '%s    "%s": {\n' "$sep" "$file"
+  psep=""
+  for phase in open scroll search edit save; do
+    # every run edits a fresh copy
+    ext=${file##*.}
+    cp "$DIR/$file" "$DIR/run.$ext"
+    # a run that failed has a report with nothing timed in it
+    if ! "$CHARM" --headless --json --size "$SIZE" --keys "$DIR/$phase.keys" \
+      "$DIR/run.$ext" > /dev/null 2> "$DIR/report"; then
+      echo "$CHARM failed on $file $phase:" >&2
+      cat "$DIR/report" >&2
+      exit 1
+    fi
+    printf '%s      "%s": %s' "$psep" "$phase" "$(tail -n 1 "$DIR/report")"
+    psep=",
+"
+  done
+  printf '\n    }'
+  sep=",
+"
+done
+printf '\n  }\n}\n'
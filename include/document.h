@@ -0,0 +1,20 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef document_h
+#define document_h
+
+#include <stddef.h>
+
+#include "editor.h"
+
+/*** document ***/
+
+/* Files are mapped read-only and the rows loaded from them point straight
+ * into the mapping, so an unedited file costs little more than its size. A
+ * row is copied into memory of its own the first time it is changed. */
+
+char *editorDocMap(const char *filename, size_t *len);
+int editorDocIsMapped(const char *p);
+void editorRowOwn(erow *row);
+int editorDocSave(const char *filename, const char *buf, int len);
+
+#endif
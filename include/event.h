@@ -0,0 +1,21 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef event_h
+#define event_h
+
+/*** event loop ***/
+
+/* Everything the editor waits on goes through one poll: the terminal, any
+ * fd registered with a callback, and one-shot timers. While nothing is
+ * ready the idle functions run, each doing a short slice of background
+ * work and returning nonzero while it has more. Once they are all done the
+ * loop sleeps in poll until something happens. */
+
+void editorEventWatch(int fd, void (*fn)(int fd));
+void editorEventTimer(int ms, void (*fn)());
+void editorEventIdle(int (*fn)());
+
+/* Run the loop until fd can be read, or ms have passed if ms isn't
+ * negative. Returns 1 if fd is readable. */
+int editorEventWait(int fd, int ms);
+
+#endif
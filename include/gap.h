@@ -0,0 +1,29 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef gap_h
+#define gap_h
+
+#include "editor.h"
+
+/*** gap buffer ***/
+
+/* Typing goes through a gap kept at the cursor of the row being edited, so
+ * a run of inserts or backspaces is O(1) each instead of a realloc and a
+ * memmove of the rest of the line. While the gap is open that row's chars
+ * are not contiguous. editorGapRender brings its render and hl up to date
+ * for a frame from the text either side of the gap and leaves it open.
+ * editorGapClose puts the row back together and must run before anything
+ * other than drawing looks at its chars: splitting or joining rows,
+ * saving, searching, any key that isn't typing. */
+
+void editorGapInsert(erow *row, int at, int c);
+void editorGapDelete(erow *row, int at);
+void editorGapRender();
+void editorGapClose();
+
+/* Rebuild a row's render from column 'from' onwards, in charm.c */
+void editorUpdateRowFrom(erow *row, int from);
+
+/* Relex a row after its text changed, in charm.c */
+void editorUpdateSyntax(erow *row);
+
+#endif
@@ -0,0 +1,30 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef highlight_h
+#define highlight_h
+
+#include "editor.h"
+
+/*** syntax highlighting ***/
+
+/* Each filetype is compiled once into a table giving the class of every
+ * byte, which says which rules could apply to it. A row is then lexed in
+ * a single forward pass with a few states (code, string, comment) and the
+ * table deciding what each byte does, so a new language only needs an
+ * entry in HLDB. */
+
+void editorSyntaxCompile(struct editorSyntax *syntax);
+
+/* Highlight row->render into row->hl starting in the given line state, or
+ * find the state a row ends in from its chars without touching hl. Both
+ * return the state at the end of the row. */
+int editorSyntaxLex(erow *row, int state);
+int editorSyntaxState(erow *row, int state);
+
+/* What a line ends inside of, packed into hl_open_comment. The Markdown
+ * fence is its multi-line comment delimiter so it shares the comment bit,
+ * a string only carries on after a backslash at the end of the line. */
+#define HL_STATE_COMMENT 1
+#define HL_STATE_STRING(q) ((q) << 8)
+#define HL_STATE_QUOTE(s) (((s) >> 8) & 0xff)
+
+#endif
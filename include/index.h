@@ -0,0 +1,26 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef index_h
+#define index_h
+
+#include <stddef.h>
+
+/*** line index ***/
+
+/* Splits a mapped file into lines. The first screenful is found before
+ * editorIndexStart returns, anything past the first block is scanned by
+ * worker threads and handed out in order as it becomes ready. */
+
+void editorIndexStart(char *buf, size_t len);
+int editorIndexNext(char **line, size_t *len, int wait);
+int editorIndexPending();
+int editorIndexFd();
+
+/* How long one idle tick may spend moving lines into the editor */
+#define INDEX_SLICE_MS 10
+
+/* Insert the rows the index has ready, in charm.c. Without wait this stops
+ * after INDEX_SLICE_MS, with wait it loads the whole file. Returns the
+ * number of rows added. */
+int editorLoadRows(int wait);
+
+#endif
@@ -0,0 +1,24 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef input_h
+#define input_h
+
+/*** input ***/
+
+/* The terminal's side of input, in term.c. Keys arriving together are
+ * queued so they can all be handled before the next frame, and a bracketed
+ * paste arrives as a single PASTE_KEY with its text kept aside. */
+
+#define PASTE_KEY 2000
+
+int editorKeyPending();
+char *editorPasteText(int *len);
+
+/* Lay the editor out again whenever the terminal is resized */
+void editorWatchResize();
+
+/* For running without a terminal: take keys from a file, the session ends
+ * when the editor waits for one past its end, and use a set size */
+void editorInputFrom(int fd);
+void editorFixSize(int rows, int cols);
+
+#endif
@@ -0,0 +1,17 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef keywords_h
+#define keywords_h
+
+/*** keyword matching ***/
+
+/* A filetype's keyword list compiled into a trie, so finding the keyword
+ * at a position costs the length of the word rather than a strncmp
+ * against every entry. A trailing '|' marks a keyword2 as it always has,
+ * and where several keywords fit the one earliest in the list wins. */
+
+struct kwTrie;
+
+struct kwTrie *editorKeywordsCompile(char **keywords);
+int editorKeywordMatch(struct kwTrie *kw, const char *s, int size, int *len);
+
+#endif
@@ -0,0 +1,47 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef perf_h
+#define perf_h
+
+/*** perf ***/
+
+/* Where the time goes between a key arriving and the frame that shows it.
+ * Spans are timed with the monotonic clock and counted per frame, both go
+ * into log-linear histograms that give p50, p99 and max without keeping
+ * every sample. :perf shows them in a panel over the text and :perf file
+ * writes them out. */
+
+enum perfStat {
+  PERF_LATENCY,   /* a key arriving to the frame that shows it being written */
+  PERF_WAIT,      /* waiting in editorReadKey for a key */
+  PERF_KEY,       /* handling a key, not counting waits for more */
+  PERF_HIGHLIGHT, /* rendering and lexing rows before a frame */
+  PERF_DRAW,      /* drawing the rows into the screen grid, not highlighting */
+  PERF_WRITE,     /* writing a frame to the terminal */
+  PERF_FRAME,     /* a whole editorRefreshScreen */
+  PERF_ROWS,      /* rows lexed in a frame */
+  PERF_BYTES,     /* bytes written for a frame */
+  PERF_ALLOC,     /* allocations since the last frame, with editorAllocCount */
+  PERF_STATS
+};
+
+/* The frame budget, a key taking longer than this is counted */
+#define PERF_BUDGET_MS 16
+
+long long editorPerfNow();
+long long editorPerfBusy();
+void editorPerfAdd(int stat, long long value);
+void editorPerfWait(long long ns);
+void editorPerfCount(int stat, long long n);
+void editorPerfInput();
+void editorPerfFrame(long long start);
+
+/* Allocations the calling thread has made so far. A malloc that counts
+ * them, such as test/alloc.so, gives this, without one it is NULL. */
+long long editorAllocCount() __attribute__((weak));
+
+int editorPerfReport(char *buf, int size);
+int editorPerfDump(const char *path);
+void editorPerfToggle();
+void editorPerfDraw(int rows, int cols);
+
+#endif
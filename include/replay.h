@@ -0,0 +1,20 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef replay_h
+#define replay_h
+
+/*** replay ***/
+
+/* Runs the editor without a terminal so real editing sessions can be timed.
+ * Keys come from a file of recorded input, frames go to a sink that counts
+ * them rather than to a tty, and when the editor exits the time it took to
+ * show the file and each key took to handle and draw is reported on
+ * stderr, as a JSON object if json is set. Under a malloc that counts,
+ * test/alloc.so, so are the allocations the keys made. */
+
+/* Set up before the editor is, keys are read from fd */
+void editorHeadless(int fd, int rows, int cols, int json);
+
+/* Call step, which handles a key and draws, until the keys run out */
+void editorReplay(void (*step)());
+
+#endif
@@ -0,0 +1,23 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef rows_h
+#define rows_h
+
+#include "editor.h"
+
+/*** row storage ***/
+
+/* The rows of the open file live in a B+ tree of fixed size blocks. Each
+ * interior node caches the number of lines and bytes below it so finding,
+ * inserting or deleting line N is O(log n). Pointers returned by
+ * editorRowAt stay valid until the next insert or delete, just as they did
+ * with the old flat array. */
+
+erow *editorRowAt(int at);
+erow *editorRowsInsert(int at, erow *row);
+void editorRowsDelete(int at);
+int editorRowsIndexOf(erow *row);
+void editorRowsResize(erow *row, int delta);
+long editorRowsByteOffset(int at);
+long editorRowsBytes();
+
+#endif
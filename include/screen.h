@@ -0,0 +1,38 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef screen_h
+#define screen_h
+
+/*** screen ***/
+
+/* Frames are drawn into a grid of cells rather than straight out to the
+ * terminal. The grid from the last frame is kept, and flushing compares
+ * the two and only writes the runs of cells that changed, so typing a
+ * character costs a cursor move and a few bytes instead of a repaint. When
+ * the view scrolls the terminal is asked to move the rows itself, so only
+ * the ones scrolled in are written. */
+
+#define SCR_DEFAULT -1 /* the terminal's own colour */
+#define SCR_REVERSE 1
+
+struct scrStyle {
+  int fg, bg; /* 256 colour numbers or SCR_DEFAULT */
+  int attr;
+};
+
+struct scrCell {
+  char ch;
+  unsigned char attr;
+  short fg, bg;
+};
+
+void editorScreenBegin(int rows, int cols);
+int editorScreenPut(int y, int x, const char *s, int len, struct scrStyle st);
+void editorScreenClearEol(int y, int x, struct scrStyle st);
+void editorScreenCursor(int y, int x);
+void editorScreenScroll(int top, int bot, int n);
+void editorScreenFlush();
+void editorScreenInvalidate();
+void editorScreenSync(int on);
+void editorScreenSink(void (*fn)(const char *s, int len));
+
+#endif
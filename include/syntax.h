@@ -0,0 +1,23 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef syntax_h
+#define syntax_h
+
+#include "editor.h"
+
+/*** filetypes ***/
+
+/* The languages charm knows how to highlight, matched on file name */
+
+#define HL_HIGHLIGHT_NUMBERS (1 << 0)
+#define HL_HIGHLIGHT_STRINGS (1 << 1)
+#define HL_HIGHLIGHT_FUNC (1 << 2)
+#define HL_HIGHLIGHT_MACROS (1 << 3)
+#define HL_TEX_ENV (1 << 4)
+#define HL_MD_TITLE (1 << 5)
+
+extern struct editorSyntax HLDB[];
+extern const unsigned int HLDB_ENTRIES;
+
+int is_separator(int c);
+
+#endif
@@ -0,0 +1,23 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef trace_h
+#define trace_h
+
+/*** trace ***/
+
+/* With --trace the editor records spans (opening, highlighting, frames,
+ * searches, saves, running MT) and writes them out at exit in the Chrome
+ * trace event format, for chrome://tracing or Perfetto. Each thread has
+ * its own ring of the latest events, so recording takes no locks. When
+ * tracing is off a span costs a test of a flag.
+ *
+ *   long long span = editorTraceBegin();
+ *   ...
+ *   editorTraceEnd("open", span);
+ *
+ * name must outlive the editor, a string literal. */
+
+void editorTraceStart(const char *path);
+long long editorTraceBegin();
+void editorTraceEnd(const char *name, long long start);
+
+#endif
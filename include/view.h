@@ -0,0 +1,32 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#ifndef view_h
+#define view_h
+
+#include "editor.h"
+#include "highlight.h"
+
+/*** lazy rendering ***/
+
+/* Only rows on or near the screen have a render and hl, every other row
+ * holds just its text (render == NULL). Each row keeps the lexer state it
+ * ends in as hl_open_comment. Edits put the row on a list to relex, and
+ * relexing stops as soon as a row ends in the state it did before. What
+ * the screen doesn't need is finished off while the editor is idle. */
+
+void editorViewPrepare(int first, int last);
+int editorViewIdle();
+void editorViewInsert(int at);
+void editorViewDelete(int at);
+void editorViewInvalidate(int at);
+void editorViewReset();
+
+/* Rows kept rendered above and below the screen */
+#define VIEW_PREFETCH 64
+
+/* How long one idle tick may spend on line states */
+#define VIEW_SLICE_MS 10
+
+/* Build render from column 'from' on, in charm.c */
+void editorRenderRow(erow *row, int from);
+
+#endif
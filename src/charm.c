@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <termios.h>
@@ -19,9 +20,22 @@
 #include <unistd.h>
 
 #include "../include/buffer.h"
+#include "../include/document.h"
 #include "../include/editor.h"
+#include "../include/event.h"
+#include "../include/gap.h"
+#include "../include/highlight.h"
+#include "../include/index.h"
+#include "../include/input.h"
 #include "../include/init.h"
+#include "../include/perf.h"
+#include "../include/replay.h"
+#include "../include/rows.h"
+#include "../include/screen.h"
+#include "../include/syntax.h"
 #include "../include/term.h"
+#include "../include/trace.h"
+#include "../include/view.h"
 
 /*** defines ***/
 
@@ -29,115 +43,8 @@
 
 #define RCC_QUIT_TIMES 2
 
-#define HL_HIGHLIGHT_NUMBERS (1 << 0)
-#define HL_HIGHLIGHT_STRINGS (1 << 1)
-#define HL_HIGHLIGHT_FUNC (1 << 2)
-#define HL_HIGHLIGHT_MACROS (1 << 3)
-#define HL_TEX_ENV (1 << 4)
-#define HL_MD_TITLE (1 << 5)
-
 /*** data ***/
 
-/*** filetypes ***/
-
-char *C_HL_extensions[] = {".c", ".h", ".cpp", NULL};
-char *C_HL_keywords[] = {
-    "switch",    "if",    "while",     "for",     "break",   "continue",
-    "return",    "else",  "struct",    "union",   "typedef", "static",
-    "enum",      "class", "case",      "int|",    "long|",   "double|",
-    "float|",    "char|", "unsigned|", "signed|", "void|",   "#define|",
-    "#include|", NULL};
-
-char *GO_HL_extensions[] = {".go", NULL};
-char *GO_HL_keywords[] = {
-    "switch", "if",     "defualt", "for",     "break",   "continue", "return",
-    "else",   "struct", "package", "typedef", "static",  "enum",     "class",
-    "case",   "func",   "var",     "int|",    "string|", "uint|",    "float|",
-    "char|",  "int16|", "int32|",  "int64|",  "import|", NULL};
-
-char *MT_HL_extensions[] = {".MT", ".mt", ".mtl", NULL};
-char *MT_HL_keywords[] = {
-    "if",     "else",   "fn",       "print",   "return",   "class",
-    "this",   "break",  "continue", "switch",  "case",     "default",
-    "super",  "init|",  "len|",     "printf|", "println|", "read|",
-    "write|", "clock|", "use",      "string|", "number|",  "color|",
-    "for",    "while",  "exit|",    "clear|",  "show|",    "Cd|",
-    "Ls|",    "input|", "append|",  "delete|", "var", "let", NULL};
-
-char *RUST_HL_extensions[] = {".rs", ".RS", NULL};
-char* RUST_HL_keywords[] = {
-  // all rust reserved keywords
-  "as", "break", "const", "continue", "crate", 
-  "else", "enum", "extern", "false", "fn", "for", "if", "impl", "in", 
-  "let", "loop", "match", "mod", "move", "mut", "pub", "ref", 
-  "return", "self", "Self", "static", "struct", "super", 
-  "trait", "true", "type", "unsafe", "use", "where", "while", "async", 
-  "await", "dyn", "abstract|", "become|", "box|", "do|", "final|", 
-  "macro|", "override|", "priv|", "typeof|", "unsized|", "virtual|", 
-  "yield|", "try|", "String|", "&str|", "&|", "i8|", "i16|", "i32|",
-  "i64|", "f32|", "f64|", "char|", NULL};
-
-char *PY_HL_extensions[] = {".py", NULL};
-char *PY_HL_keywords[] = {
-    // Python keywords and built-in functions
-    "and", "as", "assert", "break", "class", "continue", "def", "del", "elif",
-    "else", "except", "exec", "finally", "for", "from", "global", "if",
-    "import", "in", "is", "lambda", "not", "or", "pass", "print", "raise",
-    "return", "try", "while", "with", "yield", "async", "await", "nonlocal",
-    "range", "xrange", "reduce", "map", "filter", "all", "any", "sum", "dir",
-    "abs", "breakpoint", "compile", "delattr", "divmod", "format", "eval",
-    "getattr", "hasattr", "hash", "help", "id", "input", "isinstance",
-    "issubclass", "len", "locals", "max", "min", "next", "open", "pow", "repr",
-    "reversed", "round", "setattr", "slice", "sorted", "super", "vars", "zip",
-    "__import__", "reload", "raw_input", "execfile", "file", "cmp",
-    "basestring",
-    // Python types
-    "buffer|", "bytearray|", "bytes|", "complex|", "float|", "frozenset|",
-    "int|", "list|", "long|", "None|", "set|", "str|", "chr|", "tuple|",
-    "bool|", "False|", "True|", "type|", "unicode|", "dict|", "ascii|", "bin|",
-    "callable|", "classmethod|", "enumerate|", "hex|", "oct|", "ord|", "iter|",
-    "memoryview|", "object|", "property|", "staticmethod|", "unichr|", NULL};
-
-char *TEX_HL_extensions[] = {".tex", NULL};
-char *TEX_HL_keywords[] = {
-    "\\usepackage", "\\documentclass", "\\author", "\\title",  "\\centering",
-    "\\maketitle",  "\\begin",         "\\end",    "$$|",      "\\newcommand",
-    "equation|", "equation}|",    "figure|", "figure}|",  "theorem|", "theorem}|", 
-    "tabular|",  "tabular}|", 
-    "document}|", "\\[", "\\]", "&", NULL};
-
-char *MD_HL_extensions[] = {".md", "README", NULL};
-char *MD_HL_keywords[] = {"-", "+", "#", "##", "###", "####", "#####", NULL};
-
-char *JAVA_HL_extensions[] = {".java", NULL};
-char *JAVA_HL_keywords[] = {"_", "abstract", "assert ", "boolean|", "Boolean|", "break",
-  "byte", "case", "catch", "char|", "class", "const", "continue", "default", "do", 
-  "double|", "else", "enum ", "extends", "final", "finally", "float|", "for", "goto", 
-  "if", "implements", "import", "instanceof", "int|", "interface", "long|", "native", 
-  "new", "non-sealed", "package", "private", "protected", "public", "return", "short|",
-  "static", "strictfp", "super", "switch", "String|", "synchronized", "this|", "throw",
-  "throws", "transient", "try", "void|", "volatile", "while", "true|", "false|", "isinstanceof", NULL };
-
-struct editorSyntax HLDB[] = {
-    {"C", C_HL_extensions, C_HL_keywords, "//", "/*", "*/",
-     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC},
-    {"Go", GO_HL_extensions, GO_HL_keywords, "//", "/*", "*/",
-     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC},
-    {"MT", MT_HL_extensions, MT_HL_keywords, "//", "/*", "*/",
-     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC},
-    {"Rust", RUST_HL_extensions, RUST_HL_keywords, "//", "/*", "*/",
-      HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC | HL_HIGHLIGHT_MACROS },
-    {"Python", PY_HL_extensions, PY_HL_keywords, "#", "/*", "*/",
-     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC},
-    {"Java", JAVA_HL_extensions, JAVA_HL_keywords, "//", "/*", "*/",
-      HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC},
-    {"LaTeX", TEX_HL_extensions, TEX_HL_keywords, "%", "", "",
-     HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_NUMBERS | HL_TEX_ENV},
-    {"Markdown", MD_HL_extensions, MD_HL_keywords, "%", "```",  "```", HL_HIGHLIGHT_NUMBERS | HL_MD_TITLE}};
-
-
-#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
-
 /*** prototypes ***/
 
 void editorDeleteChar();
@@ -156,235 +63,44 @@ void editorMoveCursor(int key);
 
 /*** highlighting rules ***/
 
-int is_separator(int c) {
-  return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
-}
-
-void editorUpdateVisual() 
-{
+/* The selection is drawn over the highlighting by editorDrawRows, all
+ * that is left to do here is show the mode */
+void editorUpdateVisual() {
   // if we have exited visual mode
-  if (E.visualy == -1 || E.visualx == -1) {
+  if (E.visualy == -1 || E.visualx == -1)
     editorSetStatusMessage("  NORMAL");
-    return;
-  }
-  if (E.visualy > E.cy)
-  {
-    for (int i = E.cy; i <= E.visualy; i++)
-    {
-
-      for (int j = 0; j < strlen(E.row[i].chars); j++)
-      {
-        E.row[i].hl[j] = HL_VISUAL;
-      }
-    }
-  }
-  else 
-  {
-    for (int i = E.visualy; i <= E.cy; i++) {
-      for (int j = 0; j < strlen(E.row[i].chars); j++) {
-        E.row[i].hl[j] = HL_VISUAL;
-      }
-    } 
-  }
-}
-
-
-void editorUpdateVisualLine() 
-{
-  // if we have exited visual mode
-  if (E.visualy == -1 || E.visualx == -1) {
-    editorSetStatusMessage("  NORMAL");
-    return;
-  }
-  if (E.visualy > E.cy)
-  {
-    for (int i = E.cy; i <= E.visualy; i++)
-    {
-
-      for (int j = 0; j < strlen(E.row[i].chars); j++)
-      {
-        E.row[i].hl[j] = HL_VISUAL;
-      }
-    }
-  }
-  else 
-  {
-    for (int i = E.visualy; i <= E.cy; i++) {
-      for (int j = 0; j < strlen(E.row[i].chars); j++) {
-        E.row[i].hl[j] = HL_VISUAL;
-      }
-    } 
-  }
 }
 
 // get all the text in the selection
 char* getVisualText() 
 {
-  char* buffer = malloc(sizeof(char)*100000);
+  int cap = 100000;
+  char* buffer = malloc(sizeof(char)*cap);
+  int len = 0;
+  int start = (E.cx < E.visualx) ? E.cy : E.visualy;
+  int end = (E.cx < E.visualx) ? E.visualy : E.cy;
 
-  if (E.cx < E.visualx) 
-  {
-    for (int i = E.cy; i <= E.visualy; i++) 
-    {
-      strcat(buffer, E.row[i].chars);
-    }
-  } 
-  else 
+  for (int i = start; i <= end && i < E.numrows; i++) 
   {
-      for (int i = E.visualy; i <= E.cy; i++ )
-      {
-        strcat(buffer, E.row[i].chars);
-      }
+    erow *row = editorRowAt(i);
+    int n = row->size;
+    if (len + n >= cap)
+      n = cap - len - 1;
+    memcpy(&buffer[len], row->chars, n);
+    len += n;
   }
+  buffer[len] = '\0';
 
   return buffer;
 }
 
+/* Rehighlight a row after its text changed. The state it ends in, and so
+ * any rows below that follow from it, are settled by editorViewPrepare. */
 void editorUpdateSyntax(erow *row) {
-  row->hl = realloc(row->hl, row->rsize);
-  memset(row->hl, HL_NORMAL, row->rsize);
-  if (E.syntax == NULL)
-    return;
-  char **keywords = E.syntax->keywords;
-  char *scs = E.syntax->singleline_comment_start;
-  char *mcs = E.syntax->multiline_comment_start;
-  char *mce = E.syntax->multiline_comment_end;
-  int scs_len = scs ? strlen(scs) : 0;
-  int mcs_len = mcs ? strlen(mcs) : 0;
-  int mce_len = mce ? strlen(mce) : 0;
-  int prev_sep = 1;
-  int in_string = 0;
-
-  int in_comment = (row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
-  int i = 0;
-  while (i < row->rsize) {
-    char c = row->render[i];
-    unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
-    if (scs_len && !in_string && !in_comment) {
-      if (!strncmp(&row->render[i], scs, scs_len)) {
-        memset(&row->hl[i], HL_COMMENT, row->rsize - i);
-        break;
-      }
-    }
-
-    // functions
-    if (E.syntax->flags & HL_HIGHLIGHT_FUNC) {
-      if (c == '(' && row->render[i-1] != '!') {
-        int j = i-1;
-        while ((row->render[j] != ' ' || row->render[j] != '.') && j > 0) {
-          if (row->render[j] == ' ' || row->render[j] == '.') {
-            break;
-          }
-          row->hl[j] = HL_FUNC;
-          j--;
-        } 
-      }
-    }
-
-    if (E.syntax->flags & HL_TEX_ENV) {
-      if (c == '\\' && row->size > 1) {
-        while (c != '{' && c != '\n' && c != ' ' ) {
-          c = row->render[i];
-          row->hl[i] = HL_KEYWORD1;
-          i++;
-        }
-      }
-    }
-
-    if (mcs_len && mce_len && !in_string) {
-      if (in_comment) {
-        row->hl[i] = HL_MLCOMMENT;
-        if (!strncmp(&row->render[i], mce, mce_len)) {
-          memset(&row->hl[i], HL_MLCOMMENT, mce_len);
-          i += mce_len;
-          in_comment = 0;
-          prev_sep = 1;
-          continue;
-        } else {
-          i++;
-          continue;
-        }
-      } else if (!strncmp(&row->render[i], mcs, mcs_len)) {
-        memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
-        i += mcs_len;
-        in_comment = 1;
-        continue;
-      }
-    }
-    if (E.syntax->flags & HL_HIGHLIGHT_STRINGS) {
-      if (in_string) {
-        row->hl[i] = HL_STRING;
-        if (c == '\\' && i + 1 < row->rsize) {
-          row->hl[i + 1] = HL_STRING;
-          i += 2;
-          continue;
-        }
-        if (c == in_string)
-          in_string = 0;
-        i++;
-        prev_sep = 1;
-        continue;
-      } else {
-        if (c == '"' || c == '\'') {
-          in_string = c;
-          row->hl[i] = HL_STRING;
-          i++;
-          continue;
-        }
-      }
-    }
-    if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
-      if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) ||
-          (c == '.' && prev_hl == HL_NUMBER)) {
-        row->hl[i] = HL_NUMBER;
-        i++;
-        prev_sep = 0;
-        continue;
-      }
-    }
-
-    if (E.syntax->flags & HL_HIGHLIGHT_MACROS) {
-      if (c == '!') {
-        row->hl[i] = HL_NUMBER;
-        int k = i;
-        while (row->render[k] != ' ') {
-          row->hl[k] = HL_OTHER;
-          k--;
-        } 
-      }
-    }
-
-    if (prev_sep) {
-      int j;
-      for (j = 0; keywords[j]; j++) {
-        int klen = strlen(keywords[j]);
-        int kw2 = keywords[j][klen - 1] == '|';
-        if (kw2)
-          klen--;
-        if (!strncmp(&row->render[i], keywords[j], klen) &&
-            is_separator(row->render[i + klen])) {
-
-          memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
-          i += klen;
-          break;
-        }
-      }
-      if (keywords[j] != NULL) {
-        prev_sep = 0;
-        continue;
-      }
-    }
-
-    if (prev_sep) {
-    }
-
-    prev_sep = is_separator(c);
-    i++;
-  }
-  int changed = (row->hl_open_comment != in_comment);
-  row->hl_open_comment = in_comment;
-  if (changed && row->idx + 1 < E.numrows)
-    editorUpdateSyntax(&E.row[row->idx + 1]);
+  int at = editorRowsIndexOf(row);
+  if (row->render)
+    editorSyntaxLex(row, at > 0 ? editorRowAt(at - 1)->hl_open_comment : 0);
+  editorViewInvalidate(at);
 }
 
 /* Detect file type from extension */
@@ -404,11 +120,8 @@ void editorSelectSyntaxHighlight() {
       if ((is_ext && ext && !strcmp(ext, s->filematch[i])) ||
           (!is_ext && strstr(E.filename, s->filematch[i]))) {
         E.syntax = s;
-
-        int filerow;
-        for (filerow = 0; filerow < E.numrows; filerow++) {
-          editorUpdateSyntax(&E.row[filerow]);
-        }
+        editorSyntaxCompile(s);
+        editorViewReset();
         return;
       }
       i++;
@@ -416,19 +129,24 @@ void editorSelectSyntaxHighlight() {
   }
 }
 
-void editorUpdateRow(erow *row) {
+/* Rebuild render from column 'from' on, the render before it still matches
+ * the unchanged chars in front of it */
+void editorRenderRow(erow *row, int from) {
   int tabs = 0;
   int j;
 
-  for (j = 0; j < row->size; j++)
+  if (row->render == NULL || from < 0 || from > row->size)
+    from = 0;
+  int idx = editorRowCxToRx(row, from);
+
+  for (j = from; j < row->size; j++)
     if (row->chars[j] == '\t')
       tabs++;
 
-  free(row->render);
-  row->render = malloc(row->size + tabs * (RCC_TAB_STOP - 1) + 1);
+  row->render = realloc(row->render, idx + (row->size - from) +
+                                         tabs * (RCC_TAB_STOP - 1) + 1);
 
-  int idx = 0;
-  for (j = 0; j < row->size; j++) {
+  for (j = from; j < row->size; j++) {
     if (row->chars[j] == '\t') {
       row->render[idx++] = ' ';
       while (idx % RCC_TAB_STOP != 0)
@@ -439,44 +157,57 @@ void editorUpdateRow(erow *row) {
   }
   row->render[idx] = '\0';
   row->rsize = idx;
+}
 
+/* Bring a row up to date after its text changed from column 'from' on */
+void editorUpdateRowFrom(erow *row, int from) {
+  if (row->render)
+    editorRenderRow(row, from);
   editorUpdateSyntax(row);
 }
 
-void editorInsertRow(int at, char *s, size_t len) {
+void editorUpdateRow(erow *row) { editorUpdateRowFrom(row, 0); }
+
+/* Insert a row that uses s as its text without copying it */
+void editorInsertRowView(int at, char *s, size_t len) {
   if (at < 0 || at > E.numrows)
     return;
-  E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
-  memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
-  for (int j = at + 1; j <= E.numrows; j++)
-    E.row[j].idx++;
-  E.row[at].idx = at;
-  E.row[at].size = len;
-  E.row[at].chars = malloc(len + 1);
-  memcpy(E.row[at].chars, s, len);
-  E.row[at].chars[len] = '\0';
-  E.row[at].rsize = 0;
-  E.row[at].render = NULL;
-  E.row[at].hl = NULL;
-  E.row[at].hl_open_comment = 0;
-  editorUpdateRow(&E.row[at]);
+  editorGapClose();
+  erow row;
+  row.idx = 0;
+  row.size = len;
+  row.chars = s;
+  row.rsize = 0;
+  row.render = NULL;
+  row.hl = NULL;
+  row.hl_open_comment = 0;
   E.numrows++;
+  editorRowsInsert(at, &row);
+  editorViewInsert(at);
   E.dirty++;
 }
 
+void editorInsertRow(int at, char *s, size_t len) {
+  char *chars = malloc(len + 1);
+  memcpy(chars, s, len);
+  chars[len] = '\0';
+  editorInsertRowView(at, chars, len);
+}
+
 void editorFreeRow(erow *row) {
   free(row->render);
-  free(row->chars);
+  if (!editorDocIsMapped(row->chars))
+    free(row->chars);
   free(row->hl);
 }
 
 void editorDelRow(int at) {
   if (at < 0 || at >= E.numrows)
     return;
-  editorFreeRow(&E.row[at]);
-  memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
-  for (int j = at; j < E.numrows - 1; j++)
-    E.row[j].idx--;
+  editorGapClose();
+  editorFreeRow(editorRowAt(at));
+  editorRowsDelete(at);
+  editorViewDelete(at);
   E.numrows--;
   E.dirty++;
 }
@@ -484,19 +215,25 @@ void editorDelRow(int at) {
 void editorRowInsertChar(erow *row, int at, int c) {
   if (at < 0 || at > row->size)
     at = row->size;
+  editorGapClose();
+  editorRowOwn(row);
   row->chars = realloc(row->chars, row->size + 2);
   memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
   row->size++;
   row->chars[at] = c;
+  editorRowsResize(row, 1);
   editorUpdateRow(row);
   E.dirty++;
 }
 
 void editorRowAppendString(erow *row, char *s, size_t len) {
+  editorGapClose();
+  editorRowOwn(row);
   row->chars = realloc(row->chars, row->size + len + 1);
   memcpy(&row->chars[row->size], s, len);
   row->size += len;
   row->chars[row->size] = '\0';
+  editorRowsResize(row, len);
   editorUpdateRow(row);
   E.dirty++;
 }
@@ -504,8 +241,11 @@ void editorRowAppendString(erow *row, char *s, size_t len) {
 void editorRowDeleteChar(erow *row, int at) {
   if (at < 0 || at >= row->size)
     return;
+  editorGapClose();
+  editorRowOwn(row);
   memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
   row->size--;
+  editorRowsResize(row, -1);
   editorUpdateRow(row);
   E.dirty++;
 }
@@ -516,7 +256,13 @@ void editorKillLine() {
   if (E.cy == 0) {
     return;
   }
-  strcpy(E.paste, E.row[E.cy].chars);
+  erow *row = editorRowAt(E.cy);
+  if (row) {
+    int len = row->size < (int)sizeof(E.paste) - 1 ? row->size
+                                                   : (int)sizeof(E.paste) - 1;
+    memcpy(E.paste, row->chars, len);
+    E.paste[len] = '\0';
+  }
   editorDelRow(E.cy);
   E.cy--;
   return;
@@ -526,7 +272,8 @@ int editorCountWhitespace(erow *row) {
   int i = 0;
   int indent = 0;
   char c;
-  while ((c = row->chars[i])) {
+  while (i < row->size) {
+    c = row->chars[i];
     if (c == ' ') {
       indent++;
     } else if (c == '\t') {
@@ -543,25 +290,26 @@ void editorAutoIndent() {
   if (E.cy != 0) {
 
     // case where last line was }
-    if (E.row[E.cy-1].chars[strlen(E.row[E.cy-1].chars)-1] == '}') 
+    erow *above_row = editorRowAt(E.cy-1);
+    if (above_row->size > 0 && above_row->chars[above_row->size-1] == '}') 
     {
-      int above = editorCountWhitespace(&E.row[E.cy-1]);
+      int above = editorCountWhitespace(editorRowAt(E.cy-1));
 
       if (above >= RCC_TAB_STOP) {
-        if (E.row[E.cy-1].chars[0] == '\t') 
+        if (editorRowAt(E.cy-1)->chars[0] == '\t') 
         {
-          editorRowDeleteChar(&E.row[E.cy-1], 0);
+          editorRowDeleteChar(editorRowAt(E.cy-1), 0);
         } else {
           for (int j = 0; j < RCC_TAB_STOP; j++) 
           {  
-            editorRowDeleteChar(&E.row[E.cy-1], 0);
+            editorRowDeleteChar(editorRowAt(E.cy-1), 0);
           }
         }
       }   
     }
 
   // normal indent
-  int level = editorCountWhitespace(&E.row[E.cy-1]);
+  int level = editorCountWhitespace(editorRowAt(E.cy-1));
 
     for (int i = 0; i < level; i++)
       editorInsertChar(' ');
@@ -582,23 +330,27 @@ static void editorCenter(void) {
 }
 
 void editorInsertChar(int c) {
-  E.current_word[E.current_word_len] = c;
-  E.current_word_len++;
+  /* nothing resets the word yet, don't let it run into E.syntax */
+  if (E.current_word_len < (int)sizeof(E.current_word) - 1)
+    E.current_word[E.current_word_len++] = c;
 
   if (E.cy == E.numrows) {
     editorInsertRow(E.numrows, "", 0);
   }
-  editorRowInsertChar(&E.row[E.cy], E.cx, c);
+  editorGapInsert(editorRowAt(E.cy), E.cx, c);
   E.cx++;
 }
 
 void editorInsertNewline() {
+  editorGapClose();
   if (E.cx == 0) {
     editorInsertRow(E.cy, "", 0);
   } else {
-    erow *row = &E.row[E.cy];
+    erow *row = editorRowAt(E.cy);
     editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
-    row = &E.row[E.cy];
+    row = editorRowAt(E.cy);
+    editorRowOwn(row);
+    editorRowsResize(row, E.cx - row->size);
     row->size = E.cx;
     row->chars[row->size] = '\0';
     editorUpdateRow(row);
@@ -607,19 +359,72 @@ void editorInsertNewline() {
   E.cx = 0;
 }
 
+/* Insert text at the cursor as it is, for a paste. The lines in between
+ * become rows straight away, and nothing is indented or paired. */
+void editorInsertText(char *s, int len) {
+  editorGapClose();
+  if (E.cy == E.numrows)
+    editorInsertRow(E.numrows, "", 0);
+
+  /* cut the row at the cursor, what was after it ends the last line */
+  erow *row = editorRowAt(E.cy);
+  int tail_len = row->size - E.cx;
+  char *tail = malloc(tail_len + 1);
+  memcpy(tail, &row->chars[E.cx], tail_len);
+  editorRowOwn(row);
+  editorRowsResize(row, E.cx - row->size);
+  row->size = E.cx;
+  row->chars[row->size] = '\0';
+
+  int i = 0, start = 0;
+  while (i < len && s[i] != '\r' && s[i] != '\n')
+    i++;
+  if (i < len) {
+    editorRowAppendString(row, s, i);
+    for (;;) {
+      /* \r\n is one line end */
+      if (s[i] == '\r' && i + 1 < len && s[i + 1] == '\n')
+        i++;
+      start = ++i;
+      while (i < len && s[i] != '\r' && s[i] != '\n')
+        i++;
+      E.cy++;
+      if (i == len)
+        break;
+      editorInsertRow(E.cy, &s[start], i - start);
+    }
+    E.cx = 0;
+  }
+
+  int last = len - start;
+  char *chars = malloc(last + tail_len + 1);
+  memcpy(chars, &s[start], last);
+  memcpy(&chars[last], tail, tail_len);
+  chars[last + tail_len] = '\0';
+  free(tail);
+  if (start == 0) {
+    editorRowAppendString(row, chars, last + tail_len);
+    free(chars);
+  } else {
+    editorInsertRowView(E.cy, chars, last + tail_len);
+  }
+  E.cx += last;
+}
+
 void editorDeleteChar() {
   if (E.cy == E.numrows)
     return;
   if (E.cx == 0 && E.cy == 0)
     return;
 
-  erow *row = &E.row[E.cy];
+  erow *row = editorRowAt(E.cy);
   if (E.cx > 0) {
-    editorRowDeleteChar(row, E.cx - 1);
+    editorGapDelete(row, E.cx - 1);
     E.cx--;
   } else {
-    E.cx = E.row[E.cy - 1].size;
-    editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
+    editorGapClose();
+    E.cx = editorRowAt(E.cy - 1)->size;
+    editorRowAppendString(editorRowAt(E.cy - 1), row->chars, row->size);
     editorDelRow(E.cy);
     E.cy--;
   }
@@ -627,7 +432,7 @@ void editorDeleteChar() {
 
 /* Like vims c keyword */
 void editorChangeInner() {
-  erow *row = &E.row[E.cy];
+  erow *row = editorRowAt(E.cy);
 
   if (E.cx == row->size) {
     return;
@@ -636,20 +441,20 @@ void editorChangeInner() {
   for (int i = 0; i < row->size; i++) {
     if (row->chars[i] == '(') {
       E.cx = i + 1;
-      while (row->chars[E.cx] != ')') {
+      while (E.cx < row->size && row->chars[E.cx] != ')') {
         editorRowDeleteChar(row, E.cx);
       }
     }
 
     if (row->chars[i] == '[') {
       E.cx = i + 1;
-      while (row->chars[E.cx] != ']') {
+      while (E.cx < row->size && row->chars[E.cx] != ']') {
         editorRowDeleteChar(row, E.cx);
       }
     }
     if (row->chars[i] == '{') {
       E.cx = i + 1;
-      while (row->chars[E.cx] != '}') {
+      while (E.cx < row->size && row->chars[E.cx] != '}') {
         editorRowDeleteChar(row, E.cx);
       }
     }
@@ -660,49 +465,92 @@ void editorChangeInner() {
 /*** file i/o ***/
 
 char *editorRowsToString(int *buflen) {
-  int totlen = 0;
+  editorGapClose();
+  int totlen = editorRowsBytes();
   int j;
-  for (j = 0; j < E.numrows; j++)
-    totlen += E.row[j].size + 1;
   *buflen = totlen;
   char *buf = malloc(totlen);
   char *p = buf;
   for (j = 0; j < E.numrows; j++) {
-    memcpy(p, E.row[j].chars, E.row[j].size);
-    p += E.row[j].size;
+    erow *row = editorRowAt(j);
+    memcpy(p, row->chars, row->size);
+    p += row->size;
     *p = '\n';
     p++;
   }
   return buf;
 }
 
+/* Move lines the index has found into the editor */
+int editorLoadRows(int wait) {
+  struct timespec start, now;
+  int dirty = E.dirty;
+  int added = 0;
+  char *line;
+  size_t len;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (editorIndexNext(&line, &len, wait)) {
+    while (len > 0 && line[len - 1] == '\r')
+      len--;
+    editorInsertRowView(E.numrows, line, len);
+    added++;
+
+    if (!wait && added % 256 == 0) {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if ((now.tv_sec - start.tv_sec) * 1000 +
+              (now.tv_nsec - start.tv_nsec) / 1000000 >=
+          INDEX_SLICE_MS)
+        break;
+    }
+  }
+  E.dirty = dirty;
+  return added;
+}
+
+/* Empty the index's pipe, the lines are taken in by editorLoadIdle */
+static void editorIndexReady(int fd) {
+  char buf[64];
+  while (read(fd, buf, sizeof(buf)) > 0)
+    ;
+}
+
+/* Take in a slice of whatever lines the index has ready */
+static int editorLoadIdle() {
+  if (!editorIndexPending() || !editorLoadRows(0))
+    return 0;
+  editorRefreshScreen();
+  return 1;
+}
+
 /* Open a file */
 void editorOpen(char *filename) {
+  long long span = editorTraceBegin();
+  editorLoadRows(1);
   free(E.filename);
   E.filename = strdup(filename);
 
   editorSelectSyntaxHighlight();
 
-  FILE *fp = fopen(filename, "r");
-  if (!fp) {
-    fp = fopen (filename, "w");
+  size_t len;
+  char *buf = editorDocMap(filename, &len);
+  if (!buf) {
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd != -1)
+      close(fd);
+    len = 0;
   }
-  char *line = NULL;
-  size_t linecap = 0;
-  ssize_t linelen;
-  while ((linelen = getline(&line, &linecap, fp)) != -1) {
-    while (linelen > 0 &&
-           (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
-      linelen--;
-    editorInsertRow(E.numrows, line, linelen);
-  }
-  free(line);
-  fclose(fp);
+
+  /* rows are views into the mapped file until they are edited, anything
+   * past the first screen is indexed in the background */
+  editorIndexStart(buf, len);
+  editorLoadRows(0);
   E.dirty = 0;
+  editorTraceEnd("open", span);
 }
 
 /* Saves an open file */
 void editorSave() {
+  editorLoadRows(1);
   if (E.filename == NULL) {
     E.filename = editorPrompt("Save as %s", NULL);
     if (E.filename == NULL) {
@@ -711,27 +559,38 @@ void editorSave() {
     }
     editorSelectSyntaxHighlight();
   }
+  long long span = editorTraceBegin();
   int len;
   char *buf = editorRowsToString(&len);
-  int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
-  if (fd != -1) {
-    if (ftruncate(fd, len) != -1) {
-      if (write(fd, buf, len) == len) {
-        close(fd);
-        free(buf);
-        E.dirty = 0;
-        editorSetStatusMessage("%d bytes written to disk", len);
-        return;
-      }
-    }
-    close(fd);
+  if (editorDocSave(E.filename, buf, len) != -1) {
+    free(buf);
+    E.dirty = 0;
+    editorSetStatusMessage("%d bytes written to disk", len);
+    editorTraceEnd("save", span);
+    return;
   }
   free(buf);
   editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+  editorTraceEnd("save", span);
 }
 
 /*** find ***/
 
+/* Case-insensitive search of a row's text, which may not be NUL
+ * terminated. Returns the column of the first match or -1. */
+int editorRowFind(erow *row, const char *query) {
+  int qlen = strlen(query);
+  int i;
+  if (qlen == 0)
+    return 0;
+  int first = tolower((unsigned char)query[0]);
+  for (i = 0; i + qlen <= row->size; i++)
+    if (tolower((unsigned char)row->chars[i]) == first &&
+        !strncasecmp(&row->chars[i], query, qlen))
+      return i;
+  return -1;
+}
+
 void editorFindCallback(char *query, int key) {
   static int last_match = -1;
   static int direction = 1;
@@ -740,7 +599,9 @@ void editorFindCallback(char *query, int key) {
   static char *saved_hl = NULL;
 
   if (saved_hl) {
-    memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
+    erow *row = editorRowAt(saved_hl_line);
+    if (row && row->render)
+      memcpy(row->hl, saved_hl, row->rsize);
     free(saved_hl);
     saved_hl = NULL;
   }
@@ -759,6 +620,7 @@ void editorFindCallback(char *query, int key) {
   }
   if (last_match == -1)
     direction = 1;
+  long long span = editorTraceBegin();
   int current = last_match;
   int i;
   for (i = 0; i < E.numrows; i++) {
@@ -767,25 +629,31 @@ void editorFindCallback(char *query, int key) {
       current = E.numrows - 1;
     else if (current == E.numrows)
       current = 0;
-    erow *row = &E.row[current];
-    char *match = strcasestr(row->render, query);
-    if (match) {
+    erow *row = editorRowAt(current);
+    int match = editorRowFind(row, query);
+    if (match != -1) {
       last_match = current;
       E.cy = current;
-      E.cx = editorRowRxToCx(row, match - row->render);
+      E.cx = match;
       E.rowoff = E.numrows;
 
+      /* the match ends up at the top of the screen */
+      editorViewPrepare(current, current + E.screenrows + VIEW_PREFETCH);
       saved_hl_line = current;
       saved_hl = malloc(row->rsize);
       memcpy(saved_hl, row->hl, row->rsize);
 
-      memset(&row->hl[match - row->render], HL_MATCH, strlen(query));
+      int rx = editorRowCxToRx(row, match);
+      int rend = editorRowCxToRx(row, match + strlen(query));
+      memset(&row->hl[rx], HL_MATCH, rend - rx);
       break;
     }
   }
+  editorTraceEnd("search", span);
 }
 
 void editorFind() {
+  editorLoadRows(1);
   int saved_cx = E.cx;
   int saved_cy = E.cy;
   int saved_coloff = E.coloff;
@@ -820,7 +688,7 @@ void editorAutoComplete() {
     if (match) {
       for (int k = 0; k < E.current_word_len; k++)
         editorDeleteChar();
-      editorRowAppendString(&E.row[E.cy], words[i], strlen(words[i]));
+      editorRowAppendString(editorRowAt(E.cy), words[i], strlen(words[i]));
       // E.cx += strlen(words[i]);
       break;
     }
@@ -868,14 +736,14 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
 }
 
 void editorMoveCursor(int key) {
-  erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+  erow *row = (E.cy >= E.numrows) ? NULL : editorRowAt(E.cy);
   switch (key) {
   case ARROW_LEFT:
     if (E.cx != 0) {
       E.cx--;
     } else if (E.cy > 0) {
       E.cy--;
-      E.cx = E.row[E.cy].size;
+      E.cx = editorRowAt(E.cy)->size;
     }
     break;
   case ARROW_RIGHT:
@@ -897,7 +765,7 @@ void editorMoveCursor(int key) {
     }
     break;
   }
-  row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+  row = (E.cy >= E.numrows) ? NULL : editorRowAt(E.cy);
   int rowlen = row ? row->size : 0;
   if (E.cx > rowlen) {
     E.cx = rowlen;
@@ -907,20 +775,34 @@ void editorMoveCursor(int key) {
 void editorProcessKeypress() {
   static int quit_times = RCC_QUIT_TIMES;
   int c = editorReadKey();
+  /* only plain typing keeps the gap open between keys */
+  if ((E.normal && E.vim) ||
+      !(c == '\t' || c == BACKSPACE || c == DEL_KEY || (c >= ' ' && c < 127)))
+    editorGapClose();
+  if (c == PASTE_KEY) {
+    int len;
+    char *text = editorPasteText(&len);
+    editorInsertText(text, len);
+    return;
+  }
   editorUpdateVisual();
   if (E.normal && E.vim) {
     // NORMAL
     
     if (E.replace_char) {
-      E.row[E.cy].chars[E.cx] = c;
-      editorUpdateRow(&E.row[E.cy]);
+      erow *row = editorRowAt(E.cy);
       E.replace_char = 0;
+      if (row == NULL || E.cx >= row->size)
+        return;
+      editorRowOwn(row);
+      row->chars[E.cx] = c;
+      editorUpdateRow(row);
       return;
     }
 
     if (E.find_mode == 1) {
-      for (int i = E.cx+1; i < E.row[E.cy].size; i++) {
-        if (E.row[E.cy].chars[i] == c) {
+      for (int i = E.cx+1; i < editorRowAt(E.cy)->size; i++) {
+        if (editorRowAt(E.cy)->chars[i] == c) {
           E.cx = i;
           E.find_mode = 0;
           return;
@@ -929,8 +811,12 @@ void editorProcessKeypress() {
       E.find_mode = 0;
       return;
     } else if (E.find_mode == 2) {
-      for (int i = E.cx+1; i >= 0; i--) {
-        if (E.row[E.cy].chars[i] == c) {
+      /* from the char before the cursor, never past the end of the row */
+      int from = E.cy < E.numrows ? editorRowAt(E.cy)->size - 1 : -1;
+      if (E.cx - 1 < from)
+        from = E.cx - 1;
+      for (int i = from; i >= 0; i--) {
+        if (editorRowAt(E.cy)->chars[i] == c) {
           E.cx = i;
           E.find_mode = 0;
           return;
@@ -961,6 +847,14 @@ void editorProcessKeypress() {
         write(STDOUT_FILENO, "\x1b[H", 3);
         exit(74);
 
+      } else if (strcmp(response, "perf") == 0) {
+        editorPerfToggle();
+      } else if (strncmp(response, "perf ", 5) == 0) {
+        if (editorPerfDump(&response[5]) == -1)
+          editorSetStatusMessage("Can't write %s: %s", &response[5],
+                                 strerror(errno));
+        else
+          editorSetStatusMessage("Perf statistics written to %s", &response[5]);
       } else if (strcmp(response, "q!") == 0) {
         
         write(STDOUT_FILENO, "\x1b[2J", 4);
@@ -973,8 +867,9 @@ void editorProcessKeypress() {
           break;
         }
         response += 3;
-        printf("got %s\n", response);
         editorOpen(response);
+        /* a new file, repaint all of it rather than what seems changed */
+        editorScreenInvalidate();
       } else if (strcmp(response, "source") == 0) {
         parseInitFile();
         break;
@@ -1020,7 +915,7 @@ void editorProcessKeypress() {
 
     case 'A':
       if (E.cy < E.numrows)
-        E.cx = E.row[E.cy].size;
+        E.cx = editorRowAt(E.cy)->size;
       E.normal = 0;
       editorSetStatusMessage("--INSERT--");
       break;
@@ -1034,7 +929,7 @@ void editorProcessKeypress() {
     case 'o':
       editorSetStatusMessage("--INSERT--");
       if (E.cy < E.numrows)
-        E.cx = E.row[E.cy].size;
+        E.cx = editorRowAt(E.cy)->size;
       E.normal = 0;
       editorInsertNewline();
       editorAutoIndent();
@@ -1044,7 +939,7 @@ void editorProcessKeypress() {
       editorSetStatusMessage("--INSERT--");
       E.cy--;
       if (E.cy < E.numrows)
-        E.cx = E.row[E.cy].size;
+        E.cx = editorRowAt(E.cy)->size;
       E.normal = 0;
       editorInsertNewline();
       editorAutoIndent();
@@ -1074,25 +969,31 @@ void editorProcessKeypress() {
       while (E.normal_mod != 0) {
 
         E.normal_mod--;
-        if (strlen(E.row[E.cy].chars) == 0) {
+        if (E.cy >= E.numrows)
+          break;
+        if (editorRowAt(E.cy)->size == 0) {
           if (E.cy < E.numrows)
             E.cy++;
           break;
         }
 
-        if (E.row[E.cy].chars[E.cx] == ' ') {
+        /* a mapped row isn't terminated, never look at chars[size] */
+        if (E.cx < editorRowAt(E.cy)->size &&
+            editorRowAt(E.cy)->chars[E.cx] == ' ') {
           E.cx++;
         }
-        while (E.row[E.cy].chars[E.cx] != ' ' && E.cy <= E.numrows) {
-          if (E.cx == strlen(E.row[E.cy].chars)) {
-            E.cx = strlen(E.row[E.cy].chars) - 1;
+        while (E.cy <= E.numrows) {
+          if (E.cx >= editorRowAt(E.cy)->size) {
+            E.cx = editorRowAt(E.cy)->size - 1;
             break;
           }
+          if (editorRowAt(E.cy)->chars[E.cx] == ' ')
+            break;
 
           if (E.cy >= E.numrows)
             break;
 
-          if (E.cx + 1 > strlen(E.row[E.cy].chars) - 1) {
+          if (E.cx + 1 > editorRowAt(E.cy)->size - 1) {
             if (E.cy < E.numrows)
               E.cy++;
             E.cx = 0;
@@ -1107,10 +1008,14 @@ void editorProcessKeypress() {
 
     case 'b':
       // handle normal backwords word
-      if (E.row[E.cy].chars[E.cx] == ' ') {
+      if (E.cy >= E.numrows)
+        break;
+      if (E.cx > 0 && E.cx < editorRowAt(E.cy)->size &&
+          editorRowAt(E.cy)->chars[E.cx] == ' ') {
         E.cx--;
       }
-      while (E.row[E.cy].chars[E.cx] != ' ') {
+      while (E.cx > 0 && (E.cx >= editorRowAt(E.cy)->size ||
+                          editorRowAt(E.cy)->chars[E.cx] != ' ')) {
         E.cx--;
       }
       editorScroll();
@@ -1148,11 +1053,6 @@ void editorProcessKeypress() {
 
         E.visualy = -1;
         E.visualx = -1;
-
-        for (int i = 0; i < E.numrows; i++)
-        {
-          editorUpdateSyntax(&E.row[i]);
-        }
       }
 
       if (E.deletemode) {
@@ -1187,11 +1087,6 @@ void editorProcessKeypress() {
       E.visualy = -1;
       E.visualx = -1;
 
-      for (int i = 0; i < E.numrows; i++)
-      {
-        editorUpdateSyntax(&E.row[i]);
-      }
-
       break;
     }
 
@@ -1205,13 +1100,16 @@ void editorProcessKeypress() {
       editorSetStatusMessage("-- VISUAL LINE --");
       E.visualx = E.cx;
       E.visualy = E.cy;
-      editorUpdateVisualLine();
       break;
     }
   
     case CTRL_KEY('a'): 
     {
-      E.row[E.cy].chars[E.cx] = (int)E.row[E.cy].chars[E.cx]+1;
+      erow *row = editorRowAt(E.cy);
+      if (row == NULL || E.cx >= row->size)
+        break;
+      editorRowOwn(row);
+      row->chars[E.cx] = (int)row->chars[E.cx]+1;
       break;
     }
 
@@ -1223,9 +1121,6 @@ void editorProcessKeypress() {
       }
       E.visualy = -1;
       E.visualx = -1;
-      for (int i = 0; i < E.numrows; i++) {
-        editorUpdateRow(&E.row[i]);
-      }
       break;
     }
       
@@ -1234,13 +1129,13 @@ void editorProcessKeypress() {
       editorSetStatusMessage("-- VISUAL --");          
       E.visualx = E.cx;
       E.visualy = E.cy;
-      editorUpdateVisual();
       break;
     }
 
     /* top and bottom */
     case 'J':
     case 'G':
+        editorLoadRows(1);
         E.cy = E.numrows-1;
 
     case 'g':
@@ -1276,11 +1171,6 @@ void editorProcessKeypress() {
         E.normal_mod = 0;
         break;
       }
-      if (E.visualx != -1 || E.visualy != -1) {
-        for (int i = 0; i < E.numrows; i++)
-          editorUpdateRow(&E.row[i]);        
-        editorUpdateVisual();
-      }
       editorMoveCursor(ARROW_UP);
       break;
       
@@ -1328,7 +1218,7 @@ void editorProcessKeypress() {
     case 'L':
     case '$':
       if (E.cy < E.numrows)
-        E.cx = E.row[E.cy].size;
+        E.cx = editorRowAt(E.cy)->size;
       break;
 
     /* Finding stuff */
@@ -1381,7 +1271,7 @@ void editorProcessKeypress() {
       break;
     case CTRL_KEY('o'):
       if (E.cy < E.numrows)
-        E.cx = E.row[E.cy].size;
+        E.cx = editorRowAt(E.cy)->size;
       editorInsertNewline();
       break;
     case CTRL_KEY('x'):
@@ -1389,20 +1279,28 @@ void editorProcessKeypress() {
       break;
 
     case CTRL_KEY('f'):
-      if (E.row[E.cy].chars[E.cx] == ' ') {
+      if (E.cy >= E.numrows)
+        break;
+      if (E.cx < editorRowAt(E.cy)->size &&
+          editorRowAt(E.cy)->chars[E.cx] == ' ') {
         E.cx++;
       }
-      while (E.row[E.cy].chars[E.cx] != ' ') {
+      while (E.cx < editorRowAt(E.cy)->size &&
+             editorRowAt(E.cy)->chars[E.cx] != ' ') {
         E.cx++;
       }
       editorScroll();
       break;
 
     case CTRL_KEY('b'):
-      if (E.row[E.cy].chars[E.cx] == ' ') {
+      if (E.cy >= E.numrows)
+        break;
+      if (E.cx > 0 && E.cx < editorRowAt(E.cy)->size &&
+          editorRowAt(E.cy)->chars[E.cx] == ' ') {
         E.cx--;
       }
-      while (E.row[E.cy].chars[E.cx] != ' ') {
+      while (E.cx > 0 && (E.cx >= editorRowAt(E.cy)->size ||
+                          editorRowAt(E.cy)->chars[E.cx] != ' ')) {
         E.cx--;
       }
       editorScroll();
@@ -1493,19 +1391,13 @@ void editorProcessKeypress() {
     quit_times = RCC_QUIT_TIMES;
   }
 
-   if (E.visualx != -1 || E.visualy != -1) {
-        for (int i = 0; i < E.numrows; i++)
-          editorUpdateRow(&E.row[i]);        
-        editorUpdateVisual();
-   }
-      
   // highlight matchng parens
-  /*if (E.row[E.cy].chars[E.cx] == ')') {
+  /*if (editorRowAt(E.cy)->chars[E.cx] == ')') {
     editorSetStatusMessage("(");
     int line = E.cy;
     for (int i = E.cx; i >= 0; i--) {
-      if (E.row[line].chars[i] == '(') {
-        editorUpdateRow(&E.row[line]);
+      if (editorRowAt(line)->chars[i] == '(') {
+        editorUpdateRow(editorRowAt(line));
         break;
       }
     }
@@ -1568,17 +1460,82 @@ void initEditor() {
   E.screencols = E.raw_screencols;
 }
 
+/* One recorded key, handled and drawn */
+static void editorReplayStep() {
+  long long span = editorTraceBegin();
+  editorProcessKeypress();
+  editorTraceEnd("key", span);
+  editorRefreshScreen();
+}
+
+static void usage() {
+  fprintf(stderr, "usage: charm [--headless] [--size WxH] [--keys file] [--json] "
+                  "[--trace out.json] [file]\n");
+  exit(1);
+}
+
 int main(int argc, char *argv[]) {
-  enableRawMode();
+  int headless = 0, json = 0;
+  int rows = 24, cols = 80;
+  char *keys = NULL;
+  int i;
+
+  for (i = 1; i < argc && !strncmp(argv[i], "--", 2); i++) {
+    if (!strcmp(argv[i], "--headless")) {
+      headless = 1;
+    } else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+      if (sscanf(argv[++i], "%dx%d", &cols, &rows) != 2 || rows < 3 || cols < 1)
+        usage();
+    } else if (!strcmp(argv[i], "--json")) {
+      json = 1;
+    } else if (!strcmp(argv[i], "--keys") && i + 1 < argc) {
+      keys = argv[++i];
+    } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+      editorTraceStart(argv[++i]);
+    } else {
+      usage();
+    }
+  }
+
+  if (headless) {
+    int fd = STDIN_FILENO;
+    if (keys && (fd = open(keys, O_RDONLY)) == -1)
+      die(keys);
+    editorHeadless(fd, rows, cols, json);
+  } else {
+    enableRawMode();
+  }
   parseInitFile();
   initEditor();
-  if (argc >= 2) {
-    editorOpen(argv[1]);
+  if (i < argc) {
+    editorOpen(argv[i]);
+  }
+
+  /* keep filling in a file that is still being indexed, and work out line
+   * states below the screen while waiting for keys */
+  editorEventWatch(editorIndexFd(), editorIndexReady);
+  if (!headless)
+    editorWatchResize();
+  editorEventIdle(editorLoadIdle);
+  editorEventIdle(editorViewIdle);
+
+  if (headless) {
+    /* the whole file is in before the first key, so runs are repeatable */
+    editorLoadRows(1);
+    editorRefreshScreen();
+    editorReplay(editorReplayStep);
   }
 
   while (1) {
+    /* keys that arrive together are all handled before the next frame */
     editorRefreshScreen();
-    editorProcessKeypress();
+    do {
+      long long start = editorPerfBusy();
+      long long span = editorTraceBegin();
+      editorProcessKeypress();
+      editorTraceEnd("key", span);
+      editorPerfAdd(PERF_KEY, editorPerfBusy() - start);
+    } while (editorKeyPending());
     /*if (E.auto_complete) {
       editorAutoComplete();
     }*/
@@ -0,0 +1,196 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "../include/document.h"
+
+/*** original file buffers ***/
+
+/* Every file we have mapped stays mapped for as long as the editor runs,
+ * rows from an earlier :e may still point into it */
+struct docMapping {
+  char *base;
+  size_t len;
+  dev_t dev;
+  ino_t ino;
+  struct docMapping *next;
+};
+
+static struct docMapping *mappings = NULL;
+
+/* Map a file read-only, returns NULL if it can't be opened. An empty file
+ * gives a non-NULL pointer with len set to 0. */
+char *editorDocMap(const char *filename, size_t *len) {
+  static char empty[1];
+  struct stat st;
+
+  *len = 0;
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return NULL;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return NULL;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    return empty;
+  }
+
+  char *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  struct docMapping *m = malloc(sizeof(struct docMapping));
+  m->base = base;
+  m->len = st.st_size;
+  m->dev = st.st_dev;
+  m->ino = st.st_ino;
+  m->next = mappings;
+  mappings = m;
+
+  *len = st.st_size;
+  return base;
+}
+
+/* Does p point into one of the original file buffers */
+int editorDocIsMapped(const char *p) {
+  struct docMapping *m;
+  for (m = mappings; m; m = m->next)
+    if (p >= m->base && p < m->base + m->len)
+      return 1;
+  return 0;
+}
+
+/* Give a row its own writable, NUL terminated copy of its text */
+void editorRowOwn(erow *row) {
+  if (row->chars && !editorDocIsMapped(row->chars))
+    return;
+  char *chars = malloc(row->size + 1);
+  if (row->size)
+    memcpy(chars, row->chars, row->size);
+  chars[row->size] = '\0';
+  row->chars = chars;
+}
+
+static int docWriteAll(int fd, const char *buf, int len) {
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/* Give the rows in m a private copy of the file at the same address, so
+ * the file under it can be written over in place */
+static int docDetach(struct docMapping *m) {
+  char *copy = malloc(m->len);
+  if (copy == NULL)
+    return -1;
+  memcpy(copy, m->base, m->len);
+  if (mmap(m->base, m->len, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+    free(copy);
+    return -1;
+  }
+  memcpy(m->base, copy, m->len);
+  free(copy);
+  mprotect(m->base, m->len, PROT_READ);
+  m->dev = 0;
+  m->ino = 0;
+  return 0;
+}
+
+static int docWriteInPlace(const char *filename, const char *buf, int len) {
+  int fd = open(filename, O_RDWR | O_CREAT, 0644);
+  if (fd == -1)
+    return -1;
+  if (ftruncate(fd, len) == -1 || docWriteAll(fd, buf, len) == -1) {
+    close(fd);
+    return -1;
+  }
+  return close(fd);
+}
+
+/* Write buf out as filename. If the file is one we have mapped, writing
+ * over it in place would change the text under the rows that still point
+ * into it, so write a new file next to the one a link resolves to, give
+ * it the old owner and mode and rename it into place. A file with other
+ * hard links, or one whose owner can't be kept, is written in place after
+ * the rows are moved off the mapping. */
+int editorDocSave(const char *filename, const char *buf, int len) {
+  struct stat st;
+  struct docMapping *m = NULL;
+
+  if (stat(filename, &st) == 0)
+    for (m = mappings; m; m = m->next)
+      if (m->dev == st.st_dev && m->ino == st.st_ino)
+        break;
+
+  if (m == NULL)
+    return docWriteInPlace(filename, buf, len);
+  if (st.st_nlink > 1) {
+    if (docDetach(m) == -1)
+      return -1;
+    return docWriteInPlace(filename, buf, len);
+  }
+
+  char *path = realpath(filename, NULL);
+  if (path == NULL)
+    return -1;
+  size_t namelen = strlen(path);
+  char *tmp = malloc(namelen + 8);
+  memcpy(tmp, path, namelen);
+  memcpy(tmp + namelen, ".XXXXXX", 8);
+  int fd = mkstemp(tmp);
+  if (fd == -1) {
+    free(tmp);
+    free(path);
+    return -1;
+  }
+  if (fchown(fd, st.st_uid, st.st_gid) == -1) {
+    close(fd);
+    unlink(tmp);
+    free(tmp);
+    free(path);
+    if (docDetach(m) == -1)
+      return -1;
+    return docWriteInPlace(filename, buf, len);
+  }
+  int ok = fchmod(fd, st.st_mode & 07777) != -1 &&
+           docWriteAll(fd, buf, len) != -1;
+  if (close(fd) == -1)
+    ok = 0;
+  if (!ok || rename(tmp, path) == -1) {
+    int saved = errno;
+    unlink(tmp);
+    free(tmp);
+    free(path);
+    errno = saved;
+    return -1;
+  }
+  free(tmp);
+  free(path);
+
+  /* the mapping now belongs to the old, unlinked file */
+  m->dev = 0;
+  m->ino = 0;
+  return 0;
+}
@@ -10,7 +10,14 @@
 
 #include "../include/buffer.h"
 #include "../include/editor.h"
+#include "../include/event.h"
+#include "../include/gap.h"
 #include "../include/init.h"
+#include "../include/perf.h"
+#include "../include/rows.h"
+#include "../include/screen.h"
+#include "../include/trace.h"
+#include "../include/view.h"
 
 /*** row operations ***/
 
@@ -41,117 +48,81 @@ int editorRowRxToCx(erow *row, int rx) {
 /* Draw stuff to the screen */
 void editorDrawRows(struct abuf *ab) {
   int y;
-
-  /* Change the backgeound color
-  char normal_bg[10];
-  sprintf(normal_bg, "\x1b[48;5;%dm", 7);
-  abAppend(ab, normal_bg, 10);
-  */
+  struct scrStyle gutter = {colors.linenumColor, colors.linenumBGColor, 0};
+  struct scrStyle text = {colors.normalColor, colors.backgroundColor, 0};
+
+  (void)ab;
+  long long start = editorPerfNow();
+  editorViewPrepare(E.rowoff - VIEW_PREFETCH,
+                    E.rowoff + E.screenrows + VIEW_PREFETCH);
+  /* drawing is timed apart from the highlighting it waits on */
+  long long draw = editorPerfNow();
+  editorPerfAdd(PERF_HIGHLIGHT, draw - start);
+
+  /* The visual mode selection is drawn over the highlighting rather than
+   * written into hl, so moving it costs nothing until the rows are drawn */
+  int sel_first = -1, sel_last = -1;
+  if (E.visualx != -1 && E.visualy != -1) {
+    sel_first = E.visualy < E.cy ? E.visualy : E.cy;
+    sel_last = E.visualy < E.cy ? E.cy : E.visualy;
+  }
 
   for (y = 0; y < E.screenrows; y++) {
-
     int filerow = y + E.rowoff;
+    int x;
 
-    char normal_bg[12];
-    sprintf(normal_bg, "\x1b[48;5;%dm", colors.backgroundColor);
     // draw line number
-    char format[16];
-    char linenum[E.linenum_indent + 1];
-    memset(linenum, ' ', E.linenum_indent);
-    snprintf(format, 4, "%%%dd", E.linenum_indent - 1);
-    if (filerow < E.numrows) {
-      snprintf(linenum, E.linenum_indent + 1, format, filerow + 1);
-    }
+    char linenum[16];
+    int numlen = E.linenum_indent - 1;
+    memset(linenum, ' ', numlen);
+    if (filerow < E.numrows)
+      snprintf(linenum, sizeof(linenum), "%*d", numlen, filerow + 1);
+    x = editorScreenPut(y, 0, linenum, numlen, gutter);
+    x = editorScreenPut(y, x, " ", 1, text);
 
-    // Get user linenumber colors
-    // orig: 244,234
-    char linenum_buffer[12];
-    sprintf(linenum_buffer, "\x1b[38;5;%dm", colors.linenumColor);
-
-    char linenumbg_buffer[12];
-    sprintf(linenumbg_buffer, "\x1b[48;5;%dm", colors.linenumBGColor);
-
-    abAppend(ab, linenum_buffer, 11);
-    abAppend(ab, linenumbg_buffer, 11);
-    abAppend(ab, linenum, E.linenum_indent);
-    abAppend(ab, "\x1b[49m", 5);
-    abAppend(ab, "\x1b[39m", 5);
-    abAppend(ab, " ", 1);
-
-    if (filerow >= E.numrows) {
-      if (E.numrows == 0 && y == E.screenrows / 3) {
-        abAppend(ab, " ", 1);
-      } else {
-        abAppend(ab, " ", 1);
-      }
-    } else {
-      int len = E.row[filerow].rsize - E.coloff;
+    if (filerow < E.numrows) {
+      erow *row = editorRowAt(filerow);
+      int len = row->rsize - E.coloff;
       if (len < 0)
         len = 0;
       if (len > E.screencols)
         len = E.screencols;
-      char *c = &E.row[filerow].render[E.coloff];
-      unsigned char *hl = &E.row[filerow].hl[E.coloff];
-      int current_color = -1;
+      char *c = &row->render[E.coloff];
+      unsigned char *hl = &row->hl[E.coloff];
+      int sel_cols = 0;
+      if (filerow >= sel_first && filerow <= sel_last)
+        sel_cols = row->rsize - E.coloff;
       int j;
       for (j = 0; j < len; j++) {
+        unsigned char h = j < sel_cols ? HL_VISUAL : hl[j];
+        struct scrStyle st = text;
+        /* If its visual mode we change the background */
+        if (h == HL_VISUAL) {
+          st.fg = 0;
+          st.bg = colors.visualColor;
+        } else if (h != HL_NORMAL) {
+          st.fg = editorSyntaxToColor(h);
+        }
         if (iscntrl(c[j])) {
           char sym = (c[j] <= 26) ? '@' + c[j] : '?';
-          abAppend(ab, "\x1b[7m", 4);
-          abAppend(ab, &sym, 1);
-          abAppend(ab, "\x1b[m", 3);
-
-          if (current_color != -1) {
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
-            abAppend(ab, normal_bg, 10);
-            abAppend(ab, buf, clen);
-          }
-        } else if (hl[j] == HL_NORMAL) {
-          if (current_color != -1) {
-            /* Change the color of normal text */
-            char normal_text[12];
-
-            sprintf(normal_text, "\x1b[38;5;%dm", colors.normalColor);
-            abAppend(ab, normal_bg, 10);
-            abAppend(ab, normal_text, strlen(normal_text));
-
-            current_color = -1;
-          }
-          abAppend(ab, &c[j], 1);
+          st.attr = SCR_REVERSE;
+          x = editorScreenPut(y, x, &sym, 1, st);
         } else {
-          int color = editorSyntaxToColor(hl[j]);
-          if (color != current_color) {
-            current_color = color;
-            char buf[16];
-            int clen = 0;
-            /* If its visual mode we change the background */
-            if (color == colors.visualColor) {
-              clen = snprintf(buf, sizeof(buf), "\x1b[48;5;%dm", color);
-              abAppend(ab, "\x1b[38;5;0m", 9);
-            } else {
-              clen = snprintf(buf, sizeof(buf), "\x1b[38;5;%dm", color);
-            }
-            abAppend(ab, buf, clen);
-          }
-          abAppend(ab, &c[j], 1);
+          x = editorScreenPut(y, x, &c[j], 1, st);
         }
       }
-      abAppend(ab, "\x1b[39m", 5);
-      abAppend(ab, normal_bg, 10);
     }
-    abAppend(ab, "\x1b[K", 3);
-    abAppend(ab, "\r\n", 2);
+    editorScreenClearEol(y, x, text);
   }
+  editorPerfAdd(PERF_DRAW, editorPerfNow() - draw);
 }
 
 void editorDrawStatusBar(struct abuf *ab) {
-  char status_bar[14];
-  sprintf(status_bar, "\x1b[48;5;%d;7m", colors.statusColor);
-  char status_bar_fg[14];
-  sprintf(status_bar_fg, "\x1b[38;5;%d;7m", 244);
-  abAppend(ab, status_bar_fg, 14);
+  struct scrStyle bar = {244, SCR_DEFAULT, SCR_REVERSE};
+  int y = E.screenrows;
   char status[80], rstatus[80];
+
+  (void)ab;
   int len = snprintf(status, sizeof(status), "%.20s - %d lines %s",
                      E.filename ? E.filename : "[No Name]", E.numrows,
                      E.dirty ? "(modified)" : "");
@@ -163,27 +134,27 @@ void editorDrawStatusBar(struct abuf *ab) {
                E.syntax ? E.syntax->filetype : "text", E.cy + 1, E.cx, percent);
   if (len > E.raw_screencols)
     len = E.raw_screencols;
-  abAppend(ab, status, len);
+  editorScreenPut(y, 0, status, len, bar);
   while (len < E.raw_screencols) {
     if (E.raw_screencols - len == rlen) {
-      abAppend(ab, rstatus, rlen);
+      editorScreenPut(y, len, rstatus, rlen, bar);
       break;
     } else {
-      abAppend(ab, " ", 1);
+      editorScreenPut(y, len, " ", 1, bar);
       len++;
     }
   }
-  abAppend(ab, "\x1b[m", 3);
-  abAppend(ab, "\r\n", 2);
 }
 
 void editorDrawMessageBar(struct abuf *ab) {
-  abAppend(ab, "\x1b[K", 3);
+  struct scrStyle plain = {SCR_DEFAULT, SCR_DEFAULT, 0};
+
+  (void)ab;
   int msglen = strlen(E.statusmessage);
   if (msglen > E.raw_screencols)
     msglen = E.raw_screencols;
   if (msglen && time(NULL) - E.statusmsg_time < 5)
-    abAppend(ab, E.statusmessage, msglen);
+    editorScreenPut(E.screenrows + 1, 0, E.statusmessage, msglen, plain);
 }
 
 void editorUpdateLinenumIndent() {
@@ -212,26 +183,29 @@ void editorClearScreen() {
 }
 
 void editorRefreshScreen() {
+  static int last_rowoff = 0;
+  long long start = editorPerfNow();
+  long long span = editorTraceBegin();
+
+  editorGapRender();
   editorUpdateLinenumIndent();
   E.screencols = E.raw_screencols - E.linenum_indent;
   editorScroll();
-  struct abuf ab = ABUF_INIT;
-  abAppend(&ab, "\x1b[?25l", 6);
-  abAppend(&ab, "\x1b[H", 3);
-  editorDrawRows(&ab);
-  editorDrawStatusBar(&ab);
-  editorDrawMessageBar(&ab);
 
-  char buf[32];
-  // snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1,// (E.rx -
-  // E.coloff) + 1 + E.linenum_indent); snprintf(buf, sizeof(buf),
-  // "\x1b[%d;%dH", (E.cy - E.rowoff) + 1, E.cx + 1);
-  snprintf(buf, sizeof(buf), "\x1b[%d;%dH", E.cy - E.rowoff + 1,
-           E.rx - E.coloff + 1 + E.linenum_indent);
-  abAppend(&ab, buf, strlen(buf));
-  abAppend(&ab, "\x1b[?25h", 6);
-  write(STDOUT_FILENO, ab.b, ab.len);
-  abFree(&ab);
+  /* the rows and bars are drawn into the screen grid, ab is not used, and
+   * only what changed since the last frame is written out */
+  editorScreenBegin(E.screenrows + 2, E.raw_screencols);
+  if (E.rowoff != last_rowoff)
+    editorScreenScroll(0, E.screenrows, E.rowoff - last_rowoff);
+  last_rowoff = E.rowoff;
+  editorDrawRows(NULL);
+  editorPerfDraw(E.screenrows, E.raw_screencols);
+  editorDrawStatusBar(NULL);
+  editorDrawMessageBar(NULL);
+  editorScreenCursor(E.cy - E.rowoff, E.rx - E.coloff + E.linenum_indent);
+  editorScreenFlush();
+  editorPerfFrame(start);
+  editorTraceEnd("render", span);
 }
 
 void editorSetStatusMessage(const char *fmt, ...) {
@@ -240,12 +214,16 @@ void editorSetStatusMessage(const char *fmt, ...) {
   vsnprintf(E.statusmessage, sizeof(E.statusmessage), fmt, ap);
   va_end(ap);
   E.statusmsg_time = time(NULL);
+  /* redraw once it has expired, the message bar counts whole seconds so
+   * leave it a little past five */
+  if (E.statusmessage[0])
+    editorEventTimer(5100, editorRefreshScreen);
 }
 
 void editorScroll() {
   E.rx = 0;
   if (E.cy < E.numrows) {
-    E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+    E.rx = editorRowCxToRx(editorRowAt(E.cy), E.cx);
   }
 
   if (E.cy < E.rowoff) {
@@ -0,0 +1,154 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include "../include/event.h"
+#include "../include/term.h"
+
+/*** event loop ***/
+
+#define EV_MAX_WATCH 8
+#define EV_MAX_TIMER 8
+#define EV_MAX_IDLE 8
+
+struct evWatch {
+  int fd;
+  void (*fn)(int fd);
+};
+
+/* A timer is identified by its callback, due is 0 when it isn't set */
+struct evTimer {
+  long long due;
+  void (*fn)();
+};
+
+static struct evWatch watches[EV_MAX_WATCH];
+static int nwatches = 0;
+static struct evTimer timers[EV_MAX_TIMER];
+static int ntimers = 0;
+static int (*idles[EV_MAX_IDLE])();
+static int nidles = 0;
+
+static long long evNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Call fn whenever fd can be read, or stop watching fd if fn is NULL */
+void editorEventWatch(int fd, void (*fn)(int fd)) {
+  int i;
+  for (i = 0; i < nwatches; i++)
+    if (watches[i].fd == fd)
+      break;
+  if (fn == NULL) {
+    if (i < nwatches)
+      watches[i] = watches[--nwatches];
+    return;
+  }
+  if (i == nwatches) {
+    if (nwatches == EV_MAX_WATCH)
+      die("editorEventWatch");
+    nwatches++;
+  }
+  watches[i].fd = fd;
+  watches[i].fn = fn;
+}
+
+/* Call fn once, ms from now. Setting a timer that is already set moves it. */
+void editorEventTimer(int ms, void (*fn)()) {
+  int i;
+  for (i = 0; i < ntimers; i++)
+    if (timers[i].fn == fn || timers[i].due == 0)
+      break;
+  if (i == ntimers) {
+    if (ntimers == EV_MAX_TIMER)
+      die("editorEventTimer");
+    ntimers++;
+  }
+  timers[i].due = evNow() + ms;
+  timers[i].fn = fn;
+}
+
+void editorEventIdle(int (*fn)()) {
+  if (nidles == EV_MAX_IDLE)
+    die("editorEventIdle");
+  idles[nidles++] = fn;
+}
+
+/* Fire the timers that are due, returns ms until the next one or -1 */
+static int evTimers() {
+  long long now = evNow();
+  long long next = -1;
+  int i;
+  for (i = 0; i < ntimers; i++) {
+    if (timers[i].due == 0)
+      continue;
+    if (timers[i].due <= now) {
+      timers[i].due = 0;
+      timers[i].fn();
+      now = evNow();
+    } else if (next == -1 || timers[i].due - now < next) {
+      next = timers[i].due - now;
+    }
+  }
+  return (int)next;
+}
+
+int editorEventWait(int fd, int ms) {
+  struct pollfd fds[EV_MAX_WATCH + 1];
+  long long until = ms < 0 ? -1 : evNow() + ms;
+  int busy = nidles > 0;
+  int i, n, polled;
+
+  for (;;) {
+    int timeout = evTimers();
+    if (until != -1) {
+      long long left = until - evNow();
+      if (left < 0)
+        left = 0;
+      if (timeout == -1 || left < timeout)
+        timeout = (int)left;
+    }
+    if (busy)
+      timeout = 0;
+
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    for (i = 0; i < nwatches; i++) {
+      fds[i + 1].fd = watches[i].fd;
+      fds[i + 1].events = POLLIN;
+    }
+    polled = nwatches;
+    n = poll(fds, polled + 1, timeout);
+    if (n == -1 && errno != EINTR)
+      die("poll");
+
+    if (n > 0) {
+      /* a callback may have dropped the watches after it */
+      for (i = 1; i <= polled; i++)
+        if (fds[i].revents && i <= nwatches && watches[i - 1].fd == fds[i].fd)
+          watches[i - 1].fn(fds[i].fd);
+      /* a pipe at its end hangs up without POLLIN, read() sees the EOF */
+      if (fds[0].revents & (POLLIN | POLLHUP))
+        return 1;
+      if (fds[0].revents)
+        die("poll");
+      busy = nidles > 0;
+      continue;
+    }
+    if (until != -1 && evNow() >= until)
+      return 0;
+
+    /* nothing ready, get on with background work */
+    if (busy) {
+      busy = 0;
+      for (i = 0; i < nidles; i++)
+        busy |= idles[i]();
+    }
+  }
+}
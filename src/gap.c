@@ -0,0 +1,168 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/document.h"
+#include "../include/gap.h"
+#include "../include/rows.h"
+#include "../include/term.h"
+
+/*** gap buffer ***/
+
+#define GAP_MIN 64
+
+/* chars[0, gap_start) and chars[gap_end, gap_cap) hold the text of gap_row,
+ * row->size is kept as the length of the text without the gap */
+static erow *gap_row = NULL;
+static int gap_start = 0;
+static int gap_end = 0;
+static int gap_cap = 0;
+/* The first column that changed since render was brought up to date,
+ * GAP_CLEAN if none did */
+static int gap_dirty = 0;
+#define GAP_CLEAN INT_MAX
+
+/* Grow the allocation so there is room for at least one more char */
+static void gapGrow() {
+  int back = gap_cap - gap_end;
+  int cap = gap_cap * 2;
+  if (cap < gap_cap + GAP_MIN)
+    cap = gap_cap + GAP_MIN;
+
+  char *chars = realloc(gap_row->chars, cap);
+  if (chars == NULL)
+    die("realloc");
+  memmove(&chars[cap - back], &chars[gap_end], back);
+  gap_row->chars = chars;
+  gap_end = cap - back;
+  gap_cap = cap;
+}
+
+/* Make sure the gap is open on row and sits just after column 'at' */
+static void gapMoveTo(erow *row, int at) {
+  if (gap_row != row) {
+    editorGapClose();
+    editorRowOwn(row);
+
+    gap_cap = row->size + GAP_MIN;
+    char *chars = realloc(row->chars, gap_cap);
+    if (chars == NULL)
+      die("realloc");
+    row->chars = chars;
+    gap_row = row;
+    gap_start = row->size;
+    gap_end = gap_cap;
+    gap_dirty = GAP_CLEAN;
+  }
+
+  if (at < gap_start) {
+    int n = gap_start - at;
+    memmove(&row->chars[gap_end - n], &row->chars[at], n);
+    gap_start -= n;
+    gap_end -= n;
+  } else if (at > gap_start) {
+    int n = at - gap_start;
+    memmove(&row->chars[gap_start], &row->chars[gap_end], n);
+    gap_start += n;
+    gap_end += n;
+  }
+}
+
+/* Insert c before column 'at' */
+void editorGapInsert(erow *row, int at, int c) {
+  if (at < 0 || at > row->size)
+    at = row->size;
+  gapMoveTo(row, at);
+  if (gap_start == gap_end)
+    gapGrow();
+
+  row->chars[gap_start++] = c;
+  row->size++;
+  if (at < gap_dirty)
+    gap_dirty = at;
+  editorRowsResize(row, 1);
+  E.dirty++;
+}
+
+/* Delete the char at column 'at' */
+void editorGapDelete(erow *row, int at) {
+  if (at < 0 || at >= row->size)
+    return;
+  gapMoveTo(row, at + 1);
+
+  gap_start--;
+  row->size--;
+  if (at < gap_dirty)
+    gap_dirty = at;
+  editorRowsResize(row, -1);
+  E.dirty++;
+}
+
+/* Close the gap and bring render up to date for the columns that changed */
+void editorGapClose() {
+  if (gap_row == NULL)
+    return;
+  erow *row = gap_row;
+  if (gap_start == gap_end)
+    gapGrow();
+  gap_row = NULL;
+
+  memmove(&row->chars[gap_start], &row->chars[gap_end], gap_cap - gap_end);
+  row->chars[row->size] = '\0';
+  if (gap_dirty != GAP_CLEAN)
+    editorUpdateRowFrom(row, gap_dirty);
+}
+
+/* Rebuild render from column 'from' on out of the text either side of the
+ * gap. from is never past gap_start, so the columns before it are whole. */
+static void gapRender(erow *row, int from) {
+  int skip = gap_end - gap_start;
+  int idx = editorRowCxToRx(row, from);
+  int tabs = 0;
+  int j;
+
+  for (j = from; j < row->size; j++)
+    if (row->chars[j < gap_start ? j : j + skip] == '\t')
+      tabs++;
+
+  row->render = realloc(row->render, idx + (row->size - from) +
+                                         tabs * (RCC_TAB_STOP - 1) + 1);
+  if (row->render == NULL)
+    die("realloc");
+
+  for (j = from; j < row->size; j++) {
+    char c = row->chars[j < gap_start ? j : j + skip];
+    if (c == '\t') {
+      row->render[idx++] = ' ';
+      while (idx % RCC_TAB_STOP != 0)
+        row->render[idx++] = ' ';
+    } else {
+      row->render[idx++] = c;
+    }
+  }
+  row->render[idx] = '\0';
+  row->rsize = idx;
+}
+
+/* Bring the gap row's render and hl up to date for a frame and leave the
+ * gap where it is, so typing doesn't move the rest of the line twice a
+ * key. The gap is closed instead when the cursor is past it on its row,
+ * the cursor's column is found from the chars in front of it, or when the
+ * row has no render to lex from. */
+void editorGapRender() {
+  if (gap_row == NULL)
+    return;
+  erow *row = gap_row;
+  if (row->render == NULL ||
+      (E.cy < E.numrows && E.cx > gap_start && editorRowAt(E.cy) == row)) {
+    editorGapClose();
+    return;
+  }
+  if (gap_dirty == GAP_CLEAN)
+    return;
+
+  gapRender(row, gap_dirty);
+  gap_dirty = GAP_CLEAN;
+  editorUpdateSyntax(row);
+}
@@ -0,0 +1,288 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/highlight.h"
+#include "../include/keywords.h"
+#include "../include/perf.h"
+#include "../include/syntax.h"
+#include "../include/term.h"
+
+/*** syntax highlighting ***/
+
+/* Byte classes. A filetype only gets the bits for the rules it has, so
+ * the lexer never asks about its flags while it runs. */
+#define LX_SEP (1 << 0)       /* ends a word */
+#define LX_SCS (1 << 1)       /* may start a single line comment */
+#define LX_MCS (1 << 2)       /* may start a multi-line comment */
+#define LX_MCE (1 << 3)       /* may end one */
+#define LX_QUOTE (1 << 4)     /* starts a string */
+#define LX_ESCAPE (1 << 5)    /* escapes the next byte in a string */
+#define LX_DIGIT (1 << 6)     /* part of a number */
+#define LX_POINT (1 << 7)     /* part of a number already started */
+#define LX_CALL (1 << 8)      /* '(' making the word before it a function */
+#define LX_MACRO (1 << 9)     /* '!' making the word before it a macro */
+#define LX_TEX (1 << 10)      /* starts a TeX command */
+#define LX_TEX_END (1 << 11)  /* ends one, and is part of it */
+#define LX_KEYWORD (1 << 12)  /* not a byte class, lets keywords be matched */
+
+/* The only rules that decide what state a line ends in */
+#define LX_STATE                                                          \
+  (LX_SCS | LX_MCS | LX_MCE | LX_QUOTE | LX_ESCAPE | LX_TEX | LX_TEX_END)
+
+/* Bytes a function or macro name stops at */
+#define LX_NAME_END (LX_SEP | LX_STATE | LX_MACRO)
+
+struct lexTable {
+  struct editorSyntax *syntax;
+  unsigned short cls[256];
+  struct kwTrie *keywords;
+  char *scs, *mcs, *mce;
+  int scs_len, mcs_len, mce_len; /* mcs_len is 0 unless both are set */
+  int strings;
+  int names;      /* LX_CALL and LX_MACRO if the filetype has them */
+  int state_mask; /* rules editorSyntaxState has to follow */
+  struct lexTable *next;
+};
+
+/* Compiled tables, one per filetype that has been opened */
+static struct lexTable *tables = NULL;
+
+/* Room to lex a row's chars into when only its end state is wanted */
+static unsigned char *scratch = NULL;
+static int scratch_cap = 0;
+
+static struct lexTable *lexTableFor(struct editorSyntax *s) {
+  struct lexTable *t;
+  int c;
+
+  if (tables && tables->syntax == s)
+    return tables;
+  for (t = tables; t; t = t->next)
+    if (t->syntax == s)
+      return t;
+
+  t = calloc(1, sizeof(struct lexTable));
+  if (t == NULL)
+    die("calloc");
+  t->syntax = s;
+  t->keywords = editorKeywordsCompile(s->keywords);
+  t->scs = s->singleline_comment_start;
+  t->mcs = s->multiline_comment_start;
+  t->mce = s->multiline_comment_end;
+  t->scs_len = t->scs ? strlen(t->scs) : 0;
+  t->mcs_len = t->mcs ? strlen(t->mcs) : 0;
+  t->mce_len = t->mce ? strlen(t->mce) : 0;
+  if (t->mcs_len == 0 || t->mce_len == 0)
+    t->mcs_len = t->mce_len = 0;
+  t->strings = s->flags & HL_HIGHLIGHT_STRINGS;
+
+  for (c = 0; c < 256; c++)
+    if (is_separator(c))
+      t->cls[c] |= LX_SEP;
+
+  if (t->scs_len)
+    t->cls[(unsigned char)t->scs[0]] |= LX_SCS;
+  if (t->mcs_len) {
+    t->cls[(unsigned char)t->mcs[0]] |= LX_MCS;
+    t->cls[(unsigned char)t->mce[0]] |= LX_MCE;
+  }
+  if (s->flags & HL_HIGHLIGHT_STRINGS) {
+    t->cls['"'] |= LX_QUOTE;
+    t->cls['\''] |= LX_QUOTE;
+    t->cls['\\'] |= LX_ESCAPE;
+  }
+  if (s->flags & HL_HIGHLIGHT_NUMBERS) {
+    for (c = '0'; c <= '9'; c++)
+      t->cls[c] |= LX_DIGIT;
+    t->cls['.'] |= LX_POINT;
+  }
+  if (s->flags & HL_HIGHLIGHT_FUNC) {
+    t->cls['('] |= LX_CALL;
+    t->names |= LX_CALL;
+  }
+  if (s->flags & HL_HIGHLIGHT_MACROS) {
+    t->cls['!'] |= LX_MACRO;
+    t->names |= LX_MACRO;
+  }
+  /* a tab is a run of spaces once rendered, class it as one for chars */
+  if (s->flags & HL_TEX_ENV) {
+    t->cls['\\'] |= LX_TEX;
+    t->cls['{'] |= LX_TEX_END;
+    t->cls[' '] |= LX_TEX_END;
+    t->cls['\t'] |= LX_TEX_END;
+  }
+
+  /* skipping over a keyword only matters to the state if it could skip
+   * over something that does */
+  t->state_mask = LX_STATE;
+  for (int j = 0; s->keywords[j]; j++)
+    for (const char *k = s->keywords[j]; *k; k++)
+      if (t->cls[(unsigned char)*k] & LX_STATE)
+        t->state_mask = ~0;
+
+  t->next = tables;
+  tables = t;
+  return t;
+}
+
+static int lexAt(const char *p, int len, int i, const char *s, int slen) {
+  return i + slen <= len && !memcmp(&p[i], s, slen);
+}
+
+/* Highlight the len bytes at p into hl, starting in the given line state
+ * and following only the rules in mask. size is the row's length in chars,
+ * which the TeX rule looks at. */
+static int lexLine(struct lexTable *t, const char *p, int len, int size,
+                   unsigned char *hl, int state, int mask) {
+  int in_string = HL_STATE_QUOTE(state);
+  int in_comment = state & HL_STATE_COMMENT;
+  int prev_sep = 1;
+  int cont = 0;
+  int i = 0;
+
+  memset(hl, HL_NORMAL, len);
+  while (i < len) {
+    char c = p[i];
+    int cls = t->cls[(unsigned char)c] & mask;
+    unsigned char prev_hl = (i > 0) ? hl[i - 1] : HL_NORMAL;
+
+    if ((cls & LX_SCS) && !in_string && !in_comment &&
+        lexAt(p, len, i, t->scs, t->scs_len)) {
+      memset(&hl[i], HL_COMMENT, len - i);
+      break;
+    }
+
+    /* a TeX command runs up to and takes in the next '{' or space, what
+     * follows goes on with that byte as c */
+    if ((cls & LX_TEX) && size > 1) {
+      do {
+        c = p[i];
+        hl[i] = HL_KEYWORD1;
+        i++;
+      } while (i < len && !(t->cls[(unsigned char)c] & LX_TEX_END));
+      if (i >= len)
+        break;
+      cls = t->cls[(unsigned char)c] & mask;
+    }
+
+    if (t->mcs_len && !in_string) {
+      int here = t->cls[(unsigned char)p[i]];
+      if (in_comment) {
+        hl[i] = HL_MLCOMMENT;
+        if ((here & LX_MCE) && lexAt(p, len, i, t->mce, t->mce_len)) {
+          memset(&hl[i], HL_MLCOMMENT, t->mce_len);
+          i += t->mce_len;
+          in_comment = 0;
+          prev_sep = 1;
+        } else {
+          i++;
+        }
+        continue;
+      } else if ((here & LX_MCS) && lexAt(p, len, i, t->mcs, t->mcs_len)) {
+        memset(&hl[i], HL_MLCOMMENT, t->mcs_len);
+        i += t->mcs_len;
+        in_comment = 1;
+        continue;
+      }
+    }
+
+    if (in_string && t->strings) {
+      hl[i] = HL_STRING;
+      if ((cls & LX_ESCAPE) && i + 1 < len) {
+        hl[i + 1] = HL_STRING;
+        i += 2;
+        continue;
+      }
+      if (cls & LX_ESCAPE)
+        cont = 1;
+      if (c == in_string)
+        in_string = 0;
+      i++;
+      prev_sep = 1;
+      continue;
+    } else if (cls & LX_QUOTE) {
+      in_string = c;
+      hl[i] = HL_STRING;
+      i++;
+      continue;
+    }
+
+    if (((cls & LX_DIGIT) && (prev_sep || prev_hl == HL_NUMBER)) ||
+        ((cls & LX_POINT) && prev_hl == HL_NUMBER)) {
+      hl[i] = HL_NUMBER;
+      i++;
+      prev_sep = 0;
+      continue;
+    }
+
+    /* a name followed by '(' is a function, by '!' a macro with the '!'.
+     * The name is looked ahead over once and written forward from its
+     * start, what isn't a call is lexed as usual. */
+    if (prev_sep && (mask & t->names)) {
+      int end = i;
+      while (end < len && !(t->cls[(unsigned char)p[end]] & LX_NAME_END))
+        end++;
+      int next = end < len ? t->cls[(unsigned char)p[end]] & mask : 0;
+      if (end > i && (next & LX_CALL)) {
+        memset(&hl[i], HL_FUNC, end - i);
+        i = end;
+        prev_sep = 0;
+        continue;
+      }
+      if (end > i && (next & LX_MACRO)) {
+        memset(&hl[i], HL_OTHER, end - i + 1);
+        i = end + 1;
+        prev_sep = 0;
+        continue;
+      }
+    }
+
+    if (prev_sep && (mask & LX_KEYWORD)) {
+      int klen;
+      int kw = editorKeywordMatch(t->keywords, &p[i], len - i, &klen);
+      if (kw) {
+        memset(&hl[i], kw, klen);
+        i += klen;
+        prev_sep = 0;
+        continue;
+      }
+    }
+
+    prev_sep = cls & LX_SEP;
+    i++;
+  }
+  return in_comment | (cont ? HL_STATE_STRING(in_string) : 0);
+}
+
+/* Build the table for a filetype ahead of its first row */
+void editorSyntaxCompile(struct editorSyntax *syntax) {
+  lexTableFor(syntax);
+}
+
+int editorSyntaxLex(erow *row, int state) {
+  editorPerfCount(PERF_ROWS, 1);
+  row->hl = realloc(row->hl, row->rsize);
+  if (E.syntax == NULL) {
+    memset(row->hl, HL_NORMAL, row->rsize);
+    return 0;
+  }
+  return lexLine(lexTableFor(E.syntax), row->render, row->rsize, row->size,
+                 row->hl, state, ~0);
+}
+
+/* The chars lex the same as the render as far as the state goes, only the
+ * columns differ, so the highlight goes to scratch and is thrown away */
+int editorSyntaxState(erow *row, int state) {
+  if (E.syntax == NULL)
+    return 0;
+  struct lexTable *t = lexTableFor(E.syntax);
+  if (row->size > scratch_cap) {
+    scratch_cap = row->size * 2;
+    scratch = realloc(scratch, scratch_cap);
+    if (scratch == NULL)
+      die("realloc");
+  }
+  return lexLine(t, row->chars, row->size, row->size, scratch, state,
+                 t->state_mask);
+}
@@ -0,0 +1,240 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../include/index.h"
+#include "../include/term.h"
+#include "../include/trace.h"
+
+/*** line index ***/
+
+#define INDEX_BLOCK (8 << 20)
+#define INDEX_FIRST_LINES 4096
+#define INDEX_MAX_WORKERS 8
+
+/* A run of the file and the offsets of the newlines in it */
+struct indexBlock {
+  size_t start, end;
+  uint32_t *nl;
+  size_t count, cap;
+  int done;
+};
+
+static char *ix_buf = NULL;
+static size_t ix_len = 0;
+static struct indexBlock *blocks = NULL;
+static int nblocks = 0;
+
+/* Handing lines out, only touched by the main thread */
+static int cur = 0;
+static int cur_ready = 0;
+static size_t cur_nl = 0;
+static size_t line_start = 0;
+static int tail_done = 1;
+
+/* Workers take blocks in order, claim is guarded by lock */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ready = PTHREAD_COND_INITIALIZER;
+static pthread_t workers[INDEX_MAX_WORKERS];
+static int nworkers = 0;
+static int claim = 0;
+static int wake[2] = {-1, -1};
+
+static void indexPush(struct indexBlock *b, size_t at) {
+  if (b->count == b->cap) {
+    b->cap = b->cap ? b->cap * 2 : 1024;
+    b->nl = realloc(b->nl, sizeof(uint32_t) * b->cap);
+    if (b->nl == NULL)
+      die("realloc");
+  }
+  b->nl[b->count++] = (uint32_t)(at - b->start);
+}
+
+/* Record every newline in the block. With a limit, stop after that many
+ * lines and shrink the block to end just after the last one. */
+static void indexScan(struct indexBlock *b, size_t limit) {
+  const char *p = ix_buf;
+  size_t i = b->start;
+
+#ifdef __SSE2__
+  const __m128i nl = _mm_set1_epi8('\n');
+  for (; i + 16 <= b->end; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+    while (mask) {
+      indexPush(b, i + __builtin_ctz(mask));
+      if (limit && b->count == limit) {
+        b->end = b->start + b->nl[b->count - 1] + 1;
+        return;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  while (i < b->end) {
+    const char *q = memchr(p + i, '\n', b->end - i);
+    if (q == NULL)
+      break;
+    indexPush(b, q - p);
+    if (limit && b->count == limit) {
+      b->end = (q - p) + 1;
+      return;
+    }
+    i = (q - p) + 1;
+  }
+}
+
+static void *indexWorker(void *arg) {
+  (void)arg;
+  for (;;) {
+    pthread_mutex_lock(&lock);
+    int i = claim++;
+    pthread_mutex_unlock(&lock);
+    if (i >= nblocks)
+      break;
+
+    long long span = editorTraceBegin();
+    indexScan(&blocks[i], 0);
+    editorTraceEnd("index block", span);
+
+    pthread_mutex_lock(&lock);
+    blocks[i].done = 1;
+    pthread_cond_broadcast(&ready);
+    pthread_mutex_unlock(&lock);
+    if (wake[1] != -1)
+      write(wake[1], "", 1);
+  }
+  return NULL;
+}
+
+static void indexReset() {
+  int i;
+  for (i = 0; i < nworkers; i++)
+    pthread_join(workers[i], NULL);
+  nworkers = 0;
+  for (i = 0; i < nblocks; i++)
+    free(blocks[i].nl);
+  free(blocks);
+  blocks = NULL;
+  nblocks = 0;
+}
+
+/* Index buf. The first block is scanned here so the caller can draw the
+ * top of the file straight away, the rest goes to the workers. */
+void editorIndexStart(char *buf, size_t len) {
+  indexReset();
+  ix_buf = buf;
+  ix_len = len;
+  cur = 0;
+  cur_ready = 0;
+  cur_nl = 0;
+  line_start = 0;
+  tail_done = 0;
+  if (len == 0)
+    return;
+
+  struct indexBlock first = {0};
+  first.end = len < INDEX_BLOCK ? len : INDEX_BLOCK;
+  indexScan(&first, INDEX_FIRST_LINES);
+  first.done = 1;
+
+  size_t rest = len - first.end;
+  nblocks = 1 + (rest + INDEX_BLOCK - 1) / INDEX_BLOCK;
+  blocks = calloc(nblocks, sizeof(struct indexBlock));
+  blocks[0] = first;
+  for (int i = 1; i < nblocks; i++) {
+    blocks[i].start = first.end + (size_t)(i - 1) * INDEX_BLOCK;
+    blocks[i].end = blocks[i].start + INDEX_BLOCK;
+    if (blocks[i].end > len)
+      blocks[i].end = len;
+  }
+
+  /* not worth a thread for a single block */
+  if (nblocks == 2) {
+    indexScan(&blocks[1], 0);
+    blocks[1].done = 1;
+    return;
+  }
+
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  int want = (ncpu < 1) ? 1 : (int)ncpu;
+  if (want > INDEX_MAX_WORKERS)
+    want = INDEX_MAX_WORKERS;
+  if (want > nblocks - 1)
+    want = nblocks - 1;
+  claim = 1;
+  for (nworkers = 0; nworkers < want; nworkers++)
+    if (pthread_create(&workers[nworkers], NULL, indexWorker, NULL) != 0)
+      break;
+
+  /* no threads at all, do it the slow way */
+  if (nworkers == 0)
+    indexWorker(NULL);
+}
+
+/* Hand out the next complete line, without its newline. Returns 0 if the
+ * next line isn't indexed yet (or, with wait, once the file is done). */
+int editorIndexNext(char **line, size_t *len, int wait) {
+  while (cur < nblocks) {
+    struct indexBlock *b = &blocks[cur];
+    if (!cur_ready) {
+      pthread_mutex_lock(&lock);
+      while (wait && !b->done)
+        pthread_cond_wait(&ready, &lock);
+      cur_ready = b->done;
+      pthread_mutex_unlock(&lock);
+      if (!cur_ready)
+        return 0;
+    }
+    if (cur_nl < b->count) {
+      size_t nl = b->start + b->nl[cur_nl++];
+      *line = ix_buf + line_start;
+      *len = nl - line_start;
+      line_start = nl + 1;
+      return 1;
+    }
+    free(b->nl);
+    b->nl = NULL;
+    cur++;
+    cur_ready = 0;
+    cur_nl = 0;
+  }
+
+  if (!tail_done) {
+    tail_done = 1;
+    indexReset();
+    if (line_start < ix_len) {
+      *line = ix_buf + line_start;
+      *len = ix_len - line_start;
+      line_start = ix_len;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int editorIndexPending() { return !tail_done; }
+
+/* A pipe the workers write a byte to as each block is done, so the main
+ * thread can sleep in poll until there are lines to take */
+int editorIndexFd() {
+  if (wake[0] == -1) {
+    if (pipe(wake) == -1)
+      die("pipe");
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake[1], F_SETFL, O_NONBLOCK);
+  }
+  return wake[0];
+}
@@ -1,7 +1,10 @@
 // Copyright (C) 2021 ramsaycarslaw
 
+#include <string.h>
+
 #include "../include/init.h"
 #include "../include/editor.h"
+#include "../include/trace.h"
 
 // adjust theme here using ANSI 3/4 bit colors
 int editorSyntaxToColor(int hl) {
@@ -64,49 +67,81 @@ static void runFile(const char *path) {
 
   char *source = readFile(path);
 
+  long long span = editorTraceBegin();
   interpret(source);
+  editorTraceEnd("interpret", span);
   free(source);
 }
 
-// parse the init file
-int parseInitFile() {
-  initVM();
+// where the init file is, $HOME/.charm.mt
+static const char *initPath() {
+  static char path[4096];
+  const char *home = getenv("HOME");
+  snprintf(path, sizeof(path), "%s/.charm.mt", home ? home : ".");
+  return path;
+}
 
-  // init file for now
-  runFile("/Users/ramsaycarslaw/.charm.mt");
-
-  /* Get the colors from the init file */
-  colors.normalColor =
-  AS_NUMBER(interpret("print ((normalColor == nil) ? 7 :  normalColor);"));
-  colors.commentColor = AS_NUMBER(interpret("print commentColor;"));
-  colors.funcColor = AS_NUMBER(interpret("print funcColor;"));
-  colors.keyword1Color = AS_NUMBER(interpret("print keyword1Color;"));
-  colors.keyword2Color = AS_NUMBER(interpret("print keyword2Color;"));
-  colors.stringColor = AS_NUMBER(interpret("print stringColor;"));
-  colors.numberColor = AS_NUMBER(interpret("print numberColor;"));
-  colors.backgroundColor = AS_NUMBER(interpret("print backgroundColor;"));
-  colors.matchColor = AS_NUMBER(interpret("print matchColor;"));
-  colors.otherColor = AS_NUMBER(interpret("print otherColor;"));
+// a number the init file left in a global, or def if it didn't, read
+// straight from the VM rather than compiling a program to print it
+static double initGlobal(const char *name, double def) {
+  Value value;
+  ObjString *key = copyString(name, (int)strlen(name));
+  if (tableGet(&vm.globals, key, &value) && IS_NUMBER(value))
+    return AS_NUMBER(value);
+  return def;
+}
+
+/* The VM lives as long as the editor once the init file has run in it, so
+ * commands see its globals and anything earlier commands left behind */
+static int vm_live = 0;
+
+/* Get the colors from the VM's globals, those it leaves out are the
+ * classic theme. Read after the init file and after every command, which
+ * may have changed them. */
+static void initReadTheme() {
+  colors.normalColor = initGlobal("normalColor", 7);
+  colors.commentColor = initGlobal("commentColor", 4);
+  colors.funcColor = initGlobal("funcColor", 34);
+  colors.keyword1Color = initGlobal("keyword1Color", 3);
+  colors.keyword2Color = initGlobal("keyword2Color", 100);
+  colors.stringColor = initGlobal("stringColor", 1);
+  colors.numberColor = initGlobal("numberColor", 123);
+  colors.backgroundColor = initGlobal("backgroundColor", 234);
+  colors.matchColor = initGlobal("matchColor", 45);
+  colors.otherColor = initGlobal("otherColor", 112);
 
   /* Window colors */
-  colors.statusColor = AS_NUMBER(interpret("print statusColor;"));
-  colors.backgroundColor = AS_NUMBER(interpret("print backgroundColor;"));
-  colors.linenumColor = AS_NUMBER(interpret("print ((linenumColor == nil) ? 244 : linenumColor);"));
-  colors.linenumBGColor = AS_NUMBER(interpret("print linenumBGColor;"));
+  colors.statusColor = initGlobal("statusColor", 244);
+  colors.linenumColor = initGlobal("linenumColor", 244);
+  colors.linenumBGColor = initGlobal("linenumBGColor", 234);
 
   colors.visualColor = 7;
 
-  E.vim = AS_NUMBER(interpret("print vim;"));
+  E.vim = initGlobal("vim", 1);
+}
 
-  freeVM();
+// parse the init file
+int parseInitFile() {
+  long long span = editorTraceBegin();
+
+  /* sourcing again starts from a clean VM */
+  if (vm_live)
+    freeVM();
+  initVM();
+  vm_live = 1;
+
+  runFile(initPath());
+  initReadTheme();
+
+  editorTraceEnd("init", span);
   return 0;
 }
 
 void editorRunFunction(const char *expr) {
-  initVM();
-
-  runFile("/Users/ramsaycarslaw/.charm.mt");
+  if (!vm_live)
+    parseInitFile();
+  long long span = editorTraceBegin();
   interpret(expr);
-
-  freeVM();
+  initReadTheme();
+  editorTraceEnd("interpret", span);
 }
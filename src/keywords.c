@@ -0,0 +1,128 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/keywords.h"
+#include "../include/syntax.h"
+#include "../include/term.h"
+
+/*** keyword matching ***/
+
+/* Children of a node are kept as a list through sibling, the first byte
+ * of a word is looked up directly in root */
+struct kwNode {
+  int child, sibling;
+  int kw; /* earliest keyword ending here, -1 if none */
+  unsigned char c;
+  unsigned char hl;
+};
+
+struct kwTrie {
+  char **keywords;
+  int root[256];
+  struct kwNode *nodes;
+  int count, cap;
+  struct kwTrie *next;
+};
+
+/* Compiled lists, one per filetype that has been opened */
+static struct kwTrie *tries = NULL;
+
+static int kwNewNode(struct kwTrie *t, unsigned char c) {
+  if (t->count == t->cap) {
+    t->cap = t->cap ? t->cap * 2 : 64;
+    t->nodes = realloc(t->nodes, sizeof(struct kwNode) * t->cap);
+    if (t->nodes == NULL)
+      die("realloc");
+  }
+  struct kwNode *n = &t->nodes[t->count];
+  n->child = -1;
+  n->sibling = -1;
+  n->kw = -1;
+  n->c = c;
+  n->hl = 0;
+  return t->count++;
+}
+
+/* The child of node n for byte c, or -1 */
+static int kwChild(struct kwTrie *t, int n, unsigned char c) {
+  int k;
+  for (k = t->nodes[n].child; k != -1; k = t->nodes[k].sibling)
+    if (t->nodes[k].c == c)
+      return k;
+  return -1;
+}
+
+static void kwAdd(struct kwTrie *t, const char *word, int len, int kw,
+                  int hl) {
+  unsigned char c = word[0];
+  if (t->root[c] == -1)
+    t->root[c] = kwNewNode(t, c);
+  int n = t->root[c];
+
+  for (int i = 1; i < len; i++) {
+    c = word[i];
+    int k = kwChild(t, n, c);
+    if (k == -1) {
+      k = kwNewNode(t, c);
+      t->nodes[k].sibling = t->nodes[n].child;
+      t->nodes[n].child = k;
+    }
+    n = k;
+  }
+  if (t->nodes[n].kw == -1) {
+    t->nodes[n].kw = kw;
+    t->nodes[n].hl = hl;
+  }
+}
+
+/* Compile a keyword list, or return the one compiled earlier */
+struct kwTrie *editorKeywordsCompile(char **keywords) {
+  struct kwTrie *t;
+  for (t = tries; t; t = t->next)
+    if (t->keywords == keywords)
+      return t;
+
+  t = calloc(1, sizeof(struct kwTrie));
+  if (t == NULL)
+    die("calloc");
+  t->keywords = keywords;
+  memset(t->root, -1, sizeof(t->root));
+  for (int j = 0; keywords[j]; j++) {
+    int klen = strlen(keywords[j]);
+    int kw2 = keywords[j][klen - 1] == '|';
+    if (kw2)
+      klen--;
+    if (klen > 0)
+      kwAdd(t, keywords[j], klen, j, kw2 ? HL_KEYWORD2 : HL_KEYWORD1);
+  }
+  t->next = tries;
+  tries = t;
+  return t;
+}
+
+/* Find the keyword that the 'size' bytes at s start with and that is
+ * followed by a separator or the end. Returns its highlight and sets len,
+ * or returns 0 if there isn't one. */
+int editorKeywordMatch(struct kwTrie *t, const char *s, int size, int *len) {
+  int best = -1;
+  int hl = 0;
+  int n = size > 0 ? t->root[(unsigned char)s[0]] : -1;
+  int depth = 1;
+
+  while (n != -1) {
+    struct kwNode *node = &t->nodes[n];
+    char next = depth < size ? s[depth] : '\0';
+    if (node->kw != -1 && (best == -1 || node->kw < best) &&
+        is_separator(next)) {
+      best = node->kw;
+      hl = node->hl;
+      *len = depth;
+    }
+    if (next == '\0')
+      break;
+    n = kwChild(t, n, next);
+    depth++;
+  }
+  return hl;
+}
@@ -0,0 +1,214 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/perf.h"
+#include "../include/screen.h"
+
+/*** perf ***/
+
+/* Values below PERF_SUB get a bucket each, above that every power of two
+ * is split into PERF_SUB / 2 buckets, so a bucket is within 1/16 of the
+ * values in it. Enough buckets for an hour in ns. */
+#define PERF_SUB 32
+#define PERF_BUCKETS 640
+
+struct perfHist {
+  long long count, max;
+  long long bucket[PERF_BUCKETS];
+};
+
+static struct perfHist hist[PERF_STATS];
+
+/* Counts for the frame being made */
+static long long frame_count[PERF_STATS];
+
+/* All the time spent waiting for keys */
+static long long waited = 0;
+
+/* When the oldest key not yet shown arrived, 0 if there isn't one */
+static long long input_at = 0;
+
+/* Allocations made up to the end of the last frame */
+static long long frame_allocs = 0;
+
+/* Keys that took longer than the budget to show */
+static long long over_budget = 0;
+
+/* Whether :perf is showing, and how wide it is */
+static int panel = 0;
+#define PERF_PANEL 52
+
+static const char *perf_names[PERF_STATS] = {
+    "key>paint", "wait", "key", "highlight", "draw",
+    "write", "frame", "rows/frame", "bytes/frame", "alloc/frame"};
+
+long long editorPerfNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* A clock that stops while waiting for keys, so a span of it is the time
+ * spent working */
+long long editorPerfBusy() {
+  return editorPerfNow() - waited;
+}
+
+static int perfBucket(long long v) {
+  int shift = 0;
+  if (v < 0)
+    v = 0;
+  while ((v >> shift) >= PERF_SUB)
+    shift++;
+  if (shift == 0)
+    return v;
+  int i = PERF_SUB + (shift - 1) * (PERF_SUB / 2) + (v >> shift) - PERF_SUB / 2;
+  return i < PERF_BUCKETS ? i : PERF_BUCKETS - 1;
+}
+
+/* The largest value that goes in bucket i */
+static long long perfBucketTop(int i) {
+  if (i < PERF_SUB)
+    return i;
+  int shift = (i - PERF_SUB) / (PERF_SUB / 2) + 1;
+  long long sub = (i - PERF_SUB) % (PERF_SUB / 2) + PERF_SUB / 2;
+  return ((sub + 1) << shift) - 1;
+}
+
+void editorPerfAdd(int stat, long long value) {
+  struct perfHist *h = &hist[stat];
+  h->bucket[perfBucket(value)]++;
+  h->count++;
+  if (value > h->max)
+    h->max = value;
+}
+
+void editorPerfWait(long long ns) {
+  waited += ns;
+  editorPerfAdd(PERF_WAIT, ns);
+}
+
+/* Add to a count that is taken at the end of the frame */
+void editorPerfCount(int stat, long long n) {
+  frame_count[stat] += n;
+}
+
+/* Keys came in, they are shown by the next frame */
+void editorPerfInput() {
+  if (input_at == 0)
+    input_at = editorPerfNow();
+}
+
+/* A frame begun at start is done */
+void editorPerfFrame(long long start) {
+  long long now = editorPerfNow();
+
+  editorPerfAdd(PERF_FRAME, now - start);
+  editorPerfAdd(PERF_ROWS, frame_count[PERF_ROWS]);
+  editorPerfAdd(PERF_BYTES, frame_count[PERF_BYTES]);
+  frame_count[PERF_ROWS] = 0;
+  frame_count[PERF_BYTES] = 0;
+  if (editorAllocCount) {
+    long long n = editorAllocCount();
+    editorPerfAdd(PERF_ALLOC, n - frame_allocs);
+    frame_allocs = n;
+  }
+  if (input_at) {
+    editorPerfAdd(PERF_LATENCY, now - input_at);
+    if (now - input_at > PERF_BUDGET_MS * 1000000LL)
+      over_budget++;
+    input_at = 0;
+  }
+}
+
+static long long perfPercentile(struct perfHist *h, int p) {
+  long long want = (h->count * p + 99) / 100;
+  long long seen = 0;
+  int i;
+  if (want == 0)
+    return 0;
+  for (i = 0; i < PERF_BUCKETS; i++) {
+    seen += h->bucket[i];
+    if (seen >= want)
+      break;
+  }
+  long long top = perfBucketTop(i);
+  return top < h->max ? top : h->max;
+}
+
+static void perfOut(char *buf, int size, int *len, const char *fmt, ...) {
+  va_list ap;
+  if (*len >= size)
+    return;
+  va_start(ap, fmt);
+  *len += vsnprintf(&buf[*len], size - *len, fmt, ap);
+  va_end(ap);
+}
+
+/* Write the statistics as lines of text into buf, returns the length */
+int editorPerfReport(char *buf, int size) {
+  int len = 0;
+  int i;
+
+  perfOut(buf, size, &len, "%-11s %8s %9s %9s %9s\n", "ms", "count", "p50",
+          "p99", "max");
+  for (i = 0; i < PERF_ROWS; i++) {
+    struct perfHist *h = &hist[i];
+    perfOut(buf, size, &len, "%-11s %8lld %9.3f %9.3f %9.3f\n", perf_names[i],
+            h->count, perfPercentile(h, 50) / 1e6, perfPercentile(h, 99) / 1e6,
+            h->max / 1e6);
+  }
+  for (; i < PERF_STATS; i++) {
+    struct perfHist *h = &hist[i];
+    /* there is nothing to count allocations without a malloc that does */
+    if (i == PERF_ALLOC && !editorAllocCount)
+      continue;
+    perfOut(buf, size, &len, "%-11s %8lld %9lld %9lld %9lld\n", perf_names[i],
+            h->count, perfPercentile(h, 50), perfPercentile(h, 99), h->max);
+  }
+  perfOut(buf, size, &len, "%lld of %lld keys over %d ms\n", over_budget,
+          hist[PERF_LATENCY].count, PERF_BUDGET_MS);
+  return len < size ? len : size - 1;
+}
+
+/* Write the statistics to a file, returns -1 if it couldn't be */
+int editorPerfDump(const char *path) {
+  char buf[2048];
+  FILE *f = fopen(path, "w");
+  if (f == NULL)
+    return -1;
+  int len = editorPerfReport(buf, sizeof(buf));
+  fwrite(buf, 1, len, f);
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+void editorPerfToggle() {
+  panel = !panel;
+}
+
+/* Draw the panel in the top right corner of the rows, if it is shown */
+void editorPerfDraw(int rows, int cols) {
+  struct scrStyle st = {SCR_DEFAULT, SCR_DEFAULT, SCR_REVERSE};
+  char buf[2048];
+  char *line = buf;
+  int left = cols > PERF_PANEL ? cols - PERF_PANEL : 0;
+  int y;
+
+  if (!panel)
+    return;
+  editorPerfReport(buf, sizeof(buf));
+  for (y = 0; y < rows && *line; y++) {
+    char *end = strchr(line, '\n');
+    int x = editorScreenPut(y, left, " ", 1, st);
+    x = editorScreenPut(y, x, line, end - line, st);
+    while (x < left + PERF_PANEL && x < cols)
+      x = editorScreenPut(y, x, " ", 1, st);
+    line = end + 1;
+  }
+}
@@ -0,0 +1,128 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../include/input.h"
+#include "../include/perf.h"
+#include "../include/replay.h"
+#include "../include/screen.h"
+#include "../include/term.h"
+
+/*** replay ***/
+
+/* What went out to the virtual terminal */
+static long long out_bytes = 0;
+static int out_frames = 0;
+
+/* When the editor started and how long it took to show the file, in ns */
+static long long start_time = 0;
+static long long open_time = 0;
+
+/* Report as a JSON object rather than for reading */
+static int report_json = 0;
+
+/* Allocations made handling keys and how many keys made any, counted when
+ * there is an editorAllocCount */
+static long long key_allocs = 0;
+static int alloc_keys = 0;
+
+/* How long each key took, in ns */
+static long long *lat = NULL;
+static int lat_len = 0;
+static int lat_cap = 0;
+
+static long long rpNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void rpSink(const char *s, int len) {
+  (void)s;
+  out_bytes += len;
+  out_frames++;
+}
+
+static int rpCompare(const void *a, const void *b) {
+  long long x = *(const long long *)a, y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+/* Latency at percentile p of the sorted times, in ms */
+static double rpPercentile(int p) {
+  return lat[(long long)(lat_len - 1) * p / 100] / 1e6;
+}
+
+static void rpReport() {
+  long long total = 0;
+  int i;
+
+  for (i = 0; i < lat_len; i++)
+    total += lat[i];
+  qsort(lat, lat_len, sizeof(*lat), rpCompare);
+
+  if (report_json) {
+    fprintf(stderr, "{\"open_ms\": %.3f, \"keys\": %d, \"output_bytes\": %lld, "
+            "\"frames\": %d", open_time / 1e6, lat_len, out_bytes, out_frames);
+    if (lat_len > 0)
+      fprintf(stderr, ", \"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, "
+              "\"p99_ms\": %.3f, \"max_ms\": %.3f, \"total_ms\": %.3f",
+              total / 1e6 / lat_len, rpPercentile(50), rpPercentile(90),
+              rpPercentile(99), rpPercentile(100), total / 1e6);
+    if (editorAllocCount)
+      fprintf(stderr, ", \"allocs\": %lld, \"alloc_keys\": %d", key_allocs,
+              alloc_keys);
+    fprintf(stderr, "}\n");
+    return;
+  }
+
+  fprintf(stderr, "open     %.3f ms\n", open_time / 1e6);
+  fprintf(stderr, "keys     %d\n", lat_len);
+  fprintf(stderr, "output   %lld bytes in %d frames", out_bytes, out_frames);
+  if (lat_len > 0)
+    fprintf(stderr, ", %.1f bytes/key", (double)out_bytes / lat_len);
+  fprintf(stderr, "\n");
+  if (lat_len == 0)
+    return;
+  fprintf(stderr, "latency  mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f ms\n",
+          total / 1e6 / lat_len, rpPercentile(50), rpPercentile(90),
+          rpPercentile(99), rpPercentile(100));
+  fprintf(stderr, "total    %.3f ms\n", total / 1e6);
+  if (editorAllocCount)
+    fprintf(stderr, "allocs   %lld by %d of the keys\n", key_allocs, alloc_keys);
+}
+
+void editorHeadless(int fd, int rows, int cols, int json) {
+  start_time = rpNow();
+  report_json = json;
+  editorInputFrom(fd);
+  editorFixSize(rows, cols);
+  editorScreenSink(rpSink);
+  /* the session may end in any of the editor's exits */
+  atexit(rpReport);
+}
+
+void editorReplay(void (*step)()) {
+  open_time = rpNow() - start_time;
+  for (;;) {
+    long long allocs = editorAllocCount ? editorAllocCount() : 0;
+    long long start = rpNow();
+    step();
+    if (editorAllocCount) {
+      long long n = editorAllocCount() - allocs;
+      key_allocs += n;
+      alloc_keys += n > 0;
+    }
+    if (lat_len == lat_cap) {
+      lat_cap = lat_cap ? lat_cap * 2 : 1024;
+      lat = realloc(lat, lat_cap * sizeof(*lat));
+      if (lat == NULL)
+        die("realloc");
+    }
+    lat[lat_len++] = rpNow() - start;
+  }
+}
@@ -0,0 +1,360 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/rows.h"
+#include "../include/term.h"
+
+/*** row tree ***/
+
+#define ROWS_LEAF_MAX 64
+#define ROWS_LEAF_MIN (ROWS_LEAF_MAX / 4)
+#define ROWS_NODE_MAX 32
+#define ROWS_NODE_MIN (ROWS_NODE_MAX / 4)
+
+typedef struct rowNode {
+  struct rowNode *parent;
+  int leaf;
+  int count; /* rows in a leaf, children in an interior node */
+  int lines; /* rows in the whole subtree */
+  long bytes; /* bytes in the subtree, counting a newline per row */
+  struct rowNode *prev, *next; /* neighbouring leaves */
+  union {
+    erow rows[ROWS_LEAF_MAX];
+    struct rowNode *child[ROWS_NODE_MAX];
+  } u;
+} rowNode;
+
+static rowNode *root = NULL;
+
+/* The last leaf we looked at, so walking the rows in order is O(1) */
+static rowNode *cache_leaf = NULL;
+static int cache_base = 0;
+
+/* Nodes are aligned to a power of two no smaller than a node, so the leaf
+ * a row is stored in can be had from the row's address */
+static size_t rowsAlign() {
+  static size_t align = 0;
+  if (align == 0)
+    for (align = 64; align < sizeof(rowNode); align <<= 1)
+      ;
+  return align;
+}
+
+static rowNode *rowsNewNode(int leaf) {
+  void *p;
+  if (posix_memalign(&p, rowsAlign(), sizeof(rowNode)) != 0)
+    die("posix_memalign");
+  rowNode *n = p;
+  memset(n, 0, sizeof(rowNode));
+  n->leaf = leaf;
+  return n;
+}
+
+/* The leaf a row of the tree is stored in */
+static rowNode *rowsLeafOf(erow *row) {
+  rowNode *leaf = (rowNode *)((uintptr_t)row & ~(uintptr_t)(rowsAlign() - 1));
+  if (!leaf->leaf || row < leaf->u.rows || row >= leaf->u.rows + leaf->count)
+    return NULL;
+  return leaf;
+}
+
+/* Row number of the first row under n, the lines to the left of it on
+ * every level up to the root */
+static int rowsBase(rowNode *n) {
+  int base = 0;
+  for (; n->parent; n = n->parent) {
+    rowNode *p = n->parent;
+    int i;
+    for (i = 0; p->u.child[i] != n; i++)
+      base += p->u.child[i]->lines;
+  }
+  return base;
+}
+
+static int rowsChildIndex(rowNode *parent, rowNode *child) {
+  int i;
+  for (i = 0; i < parent->count; i++)
+    if (parent->u.child[i] == child)
+      return i;
+  return -1;
+}
+
+/* Recount a node from its direct children */
+static void rowsRecount(rowNode *n) {
+  int i;
+  n->lines = 0;
+  n->bytes = 0;
+  if (n->leaf) {
+    n->lines = n->count;
+    for (i = 0; i < n->count; i++)
+      n->bytes += n->u.rows[i].size + 1;
+    return;
+  }
+  for (i = 0; i < n->count; i++) {
+    n->u.child[i]->parent = n;
+    n->lines += n->u.child[i]->lines;
+    n->bytes += n->u.child[i]->bytes;
+  }
+}
+
+/* Add lines and bytes to a node and everything above it */
+static void rowsPropagate(rowNode *n, int lines, long bytes) {
+  for (; n; n = n->parent) {
+    n->lines += lines;
+    n->bytes += bytes;
+  }
+}
+
+/* Find the leaf holding row 'at', and the index of that row inside it */
+static rowNode *rowsFindLeaf(int at, int *slot) {
+  if (cache_leaf && at >= cache_base && at < cache_base + cache_leaf->count) {
+    *slot = at - cache_base;
+    return cache_leaf;
+  }
+
+  rowNode *n = root;
+  int base = 0;
+  while (!n->leaf) {
+    int i = 0;
+    while (i < n->count - 1 && at - base >= n->u.child[i]->lines) {
+      base += n->u.child[i]->lines;
+      i++;
+    }
+    n = n->u.child[i];
+  }
+  cache_leaf = n;
+  cache_base = base;
+  *slot = at - base;
+  return n;
+}
+
+static void rowsInsertChild(rowNode *parent, int at, rowNode *child);
+
+/* Split a full node in two, the new right half goes in after it */
+static rowNode *rowsSplit(rowNode *n) {
+  rowNode *right = rowsNewNode(n->leaf);
+  int keep = n->count / 2;
+
+  if (n->parent == NULL) {
+    root = rowsNewNode(0);
+    root->count = 1;
+    root->u.child[0] = n;
+    rowsRecount(root);
+  }
+
+  right->count = n->count - keep;
+  if (n->leaf) {
+    memcpy(right->u.rows, &n->u.rows[keep], sizeof(erow) * right->count);
+    right->next = n->next;
+    right->prev = n;
+    if (n->next)
+      n->next->prev = right;
+    n->next = right;
+  } else {
+    memcpy(right->u.child, &n->u.child[keep],
+           sizeof(rowNode *) * right->count);
+  }
+  n->count = keep;
+  rowsRecount(n);
+  rowsRecount(right);
+  rowsInsertChild(n->parent, rowsChildIndex(n->parent, n) + 1, right);
+  return right;
+}
+
+static void rowsInsertChild(rowNode *parent, int at, rowNode *child) {
+  memmove(&parent->u.child[at + 1], &parent->u.child[at],
+          sizeof(rowNode *) * (parent->count - at));
+  parent->u.child[at] = child;
+  parent->count++;
+  child->parent = parent;
+  if (parent->count == ROWS_NODE_MAX)
+    rowsSplit(parent);
+}
+
+static void rowsRemoveChild(rowNode *parent, int at) {
+  memmove(&parent->u.child[at], &parent->u.child[at + 1],
+          sizeof(rowNode *) * (parent->count - at - 1));
+  parent->count--;
+}
+
+/* Fold undersized nodes into a neighbour and shrink the tree upwards */
+static void rowsRebalance(rowNode *n) {
+  while (n->parent) {
+    int min = n->leaf ? ROWS_LEAF_MIN : ROWS_NODE_MIN;
+    int max = n->leaf ? ROWS_LEAF_MAX : ROWS_NODE_MAX - 1;
+    rowNode *parent = n->parent;
+    int i = rowsChildIndex(parent, n);
+
+    if (n->count >= min && n->count > 0)
+      break;
+
+    rowNode *left = (i > 0) ? parent->u.child[i - 1] : NULL;
+    rowNode *right = (i + 1 < parent->count) ? parent->u.child[i + 1] : NULL;
+    rowNode *into = NULL, *from = NULL;
+    if (left && left->count + n->count <= max) {
+      into = left;
+      from = n;
+    } else if (right && right->count + n->count <= max) {
+      into = n;
+      from = right;
+    } else if (n->count > 0 || parent->count == 1) {
+      break;
+    }
+
+    if (from == NULL) {
+      /* an empty node nobody can absorb */
+      if (n->leaf) {
+        if (n->prev)
+          n->prev->next = n->next;
+        if (n->next)
+          n->next->prev = n->prev;
+      }
+      rowsRemoveChild(parent, i);
+      if (cache_leaf == n)
+        cache_leaf = NULL;
+      free(n);
+    } else {
+      if (from->leaf) {
+        memcpy(&into->u.rows[into->count], from->u.rows,
+               sizeof(erow) * from->count);
+        into->next = from->next;
+        if (from->next)
+          from->next->prev = into;
+      } else {
+        memcpy(&into->u.child[into->count], from->u.child,
+               sizeof(rowNode *) * from->count);
+      }
+      into->count += from->count;
+      rowsRecount(into);
+      rowsRemoveChild(parent, rowsChildIndex(parent, from));
+      if (cache_leaf == from || cache_leaf == into)
+        cache_leaf = NULL;
+      free(from);
+    }
+    n = parent;
+  }
+
+  /* collapse a root with a single child */
+  while (!root->leaf && root->count == 1) {
+    rowNode *old = root;
+    root = root->u.child[0];
+    root->parent = NULL;
+    free(old);
+  }
+}
+
+/*** row api ***/
+
+erow *editorRowAt(int at) {
+  int slot;
+  if (root == NULL || at < 0 || at >= root->lines)
+    return NULL;
+  rowNode *leaf = rowsFindLeaf(at, &slot);
+  return &leaf->u.rows[slot];
+}
+
+/* Copy row into the tree so it becomes row 'at', returns the stored row */
+erow *editorRowsInsert(int at, erow *row) {
+  int slot;
+  if (root == NULL)
+    root = rowsNewNode(1);
+  if (at < 0 || at > root->lines)
+    return NULL;
+
+  rowNode *leaf;
+  if (at == root->lines) {
+    /* appending, the last leaf is as far right as we can go */
+    leaf = root;
+    while (!leaf->leaf)
+      leaf = leaf->u.child[leaf->count - 1];
+    slot = leaf->count;
+  } else {
+    leaf = rowsFindLeaf(at, &slot);
+  }
+  cache_leaf = NULL;
+
+  if (leaf->count == ROWS_LEAF_MAX) {
+    rowNode *right = rowsSplit(leaf);
+    if (slot > leaf->count) {
+      slot -= leaf->count;
+      leaf = right;
+    }
+  }
+
+  memmove(&leaf->u.rows[slot + 1], &leaf->u.rows[slot],
+          sizeof(erow) * (leaf->count - slot));
+  leaf->u.rows[slot] = *row;
+  leaf->count++;
+  rowsPropagate(leaf, 1, row->size + 1);
+  return &leaf->u.rows[slot];
+}
+
+/* Unlink row 'at', the caller is responsible for freeing its contents */
+void editorRowsDelete(int at) {
+  int slot;
+  if (root == NULL || at < 0 || at >= root->lines)
+    return;
+  rowNode *leaf = rowsFindLeaf(at, &slot);
+  long bytes = leaf->u.rows[slot].size + 1;
+
+  memmove(&leaf->u.rows[slot], &leaf->u.rows[slot + 1],
+          sizeof(erow) * (leaf->count - slot - 1));
+  leaf->count--;
+  rowsPropagate(leaf, -1, -bytes);
+  cache_leaf = NULL;
+  rowsRebalance(leaf);
+}
+
+/* Row number of a row pointer, O(1) for the row most recently looked up
+ * and O(log n) otherwise */
+int editorRowsIndexOf(erow *row) {
+  if (root == NULL)
+    return -1;
+  if (cache_leaf && row >= cache_leaf->u.rows &&
+      row < cache_leaf->u.rows + cache_leaf->count)
+    return cache_base + (int)(row - cache_leaf->u.rows);
+
+  rowNode *leaf = rowsLeafOf(row);
+  if (leaf == NULL)
+    return -1;
+  cache_leaf = leaf;
+  cache_base = rowsBase(leaf);
+  return cache_base + (int)(row - leaf->u.rows);
+}
+
+/* Tell the tree a row grew or shrank by delta bytes */
+void editorRowsResize(erow *row, int delta) {
+  if (delta == 0 || editorRowsIndexOf(row) == -1)
+    return;
+  rowsPropagate(cache_leaf, 0, delta);
+}
+
+/* Byte offset of the start of row 'at' in the saved file */
+long editorRowsByteOffset(int at) {
+  if (root == NULL)
+    return 0;
+  if (at >= root->lines)
+    return root->bytes;
+
+  rowNode *n = root;
+  long offset = 0;
+  while (!n->leaf) {
+    int i = 0;
+    while (i < n->count - 1 && at >= n->u.child[i]->lines) {
+      at -= n->u.child[i]->lines;
+      offset += n->u.child[i]->bytes;
+      i++;
+    }
+    n = n->u.child[i];
+  }
+  for (int i = 0; i < at; i++)
+    offset += n->u.rows[i].size + 1;
+  return offset;
+}
+
+long editorRowsBytes() { return root ? root->bytes : 0; }
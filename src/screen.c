@@ -0,0 +1,449 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/perf.h"
+#include "../include/screen.h"
+#include "../include/term.h"
+
+/*** screen ***/
+
+/* A gap of unchanged cells shorter than this is rewritten rather than
+ * jumped over, it is about what a cursor move costs */
+#define SCR_JOIN 8
+
+/* front is what the terminal shows, back is the frame being drawn */
+static struct scrCell *front = NULL;
+static struct scrCell *back = NULL;
+static int scr_rows = 0;
+static int scr_cols = 0;
+static int scr_valid = 0; /* front matches the terminal */
+static int cursor_y = 0;
+static int cursor_x = 0;
+
+/* Rows [scroll_top, scroll_bot) are expected to have moved up by scroll_n,
+ * or down when it is negative */
+static int scroll_top = 0;
+static int scroll_bot = 0;
+static int scroll_n = 0;
+
+/* Where the terminal's cursor is and the style it writes in, at_y is -1
+ * and pen_known 0 when we can't be sure */
+static int at_y = -1;
+static int at_x = 0;
+static struct scrCell pen;
+static int pen_known = 0;
+static int hidden = 0;
+
+/* The terminal takes a frame between ?2026h and ?2026l as one update */
+static int sync_output = 0;
+
+/* Where frames go instead of the terminal when there isn't one */
+static void (*sink)(const char *s, int len) = NULL;
+
+/* The bytes of the frame being flushed. The buffer is kept from frame to
+ * frame and only ever grows, so once it is big enough for a full repaint
+ * drawing never allocates. */
+static char *out = NULL;
+static int out_len = 0;
+static int out_cap = 0;
+
+/* Make room for n more bytes */
+static void scrReserve(int n) {
+  if (out_len + n <= out_cap)
+    return;
+  int cap = out_cap ? out_cap : 4096;
+  while (cap < out_len + n)
+    cap *= 2;
+  out = realloc(out, cap);
+  if (out == NULL)
+    die("realloc");
+  out_cap = cap;
+}
+
+static void scrPut(const char *s, int len) {
+  scrReserve(len);
+  memcpy(&out[out_len], s, len);
+  out_len += len;
+}
+
+/* Start drawing a frame of the given size on a blank grid */
+void editorScreenBegin(int rows, int cols) {
+  int i;
+
+  if (rows != scr_rows || cols != scr_cols) {
+    free(front);
+    free(back);
+    front = malloc(sizeof(struct scrCell) * rows * cols);
+    back = malloc(sizeof(struct scrCell) * rows * cols);
+    if (rows * cols > 0 && (front == NULL || back == NULL))
+      die("malloc");
+    scr_rows = rows;
+    scr_cols = cols;
+    scr_valid = 0;
+  }
+  for (i = 0; i < rows * cols; i++) {
+    back[i].ch = ' ';
+    back[i].attr = 0;
+    back[i].fg = SCR_DEFAULT;
+    back[i].bg = SCR_DEFAULT;
+  }
+}
+
+/* Draw len bytes of s on row y from column x, cut off at the edge of the
+ * screen. Returns the column after them. */
+int editorScreenPut(int y, int x, const char *s, int len, struct scrStyle st) {
+  int i;
+  if (y < 0 || y >= scr_rows)
+    return x + len;
+  /* a theme can give any number, those that aren't colours are ignored */
+  if (st.fg < 0 || st.fg > 255)
+    st.fg = SCR_DEFAULT;
+  if (st.bg < 0 || st.bg > 255)
+    st.bg = SCR_DEFAULT;
+  for (i = 0; i < len && x < scr_cols; i++, x++) {
+    if (x < 0)
+      continue;
+    struct scrCell *c = &back[y * scr_cols + x];
+    c->ch = s[i];
+    c->attr = st.attr;
+    c->fg = st.fg;
+    c->bg = st.bg;
+  }
+  return x;
+}
+
+/* Blank row y from column x to the end */
+void editorScreenClearEol(int y, int x, struct scrStyle st) {
+  for (; x < scr_cols; x++)
+    editorScreenPut(y, x, " ", 1, st);
+}
+
+/* Where the cursor should be left once the frame is out */
+void editorScreenCursor(int y, int x) {
+  cursor_y = y;
+  cursor_x = x;
+}
+
+/* The rows in [top, bot) now show what was n rows further down, as when
+ * the view scrolls. It is only a hint, the frame is still diffed after. */
+void editorScreenScroll(int top, int bot, int n) {
+  scroll_top = top;
+  scroll_bot = bot;
+  scroll_n = n;
+}
+
+/* Whether to send frames as synchronized updates */
+void editorScreenSync(int on) {
+  sync_output = on;
+}
+
+/* Hand frames to fn rather than writing them to the terminal */
+void editorScreenSink(void (*fn)(const char *s, int len)) {
+  sink = fn;
+}
+
+/* The terminal was written to behind our back, repaint it all next time */
+void editorScreenInvalidate() {
+  scr_valid = 0;
+  pen_known = 0;
+  at_y = -1;
+}
+
+static int scrSame(struct scrCell *a, struct scrCell *b) {
+  return a->ch == b->ch && a->attr == b->attr && a->fg == b->fg &&
+         a->bg == b->bg;
+}
+
+/* Rows with bytes outside ASCII take fewer columns than cells, so they are
+ * only ever written whole */
+static int scrWide(struct scrCell *row) {
+  int x;
+  for (x = 0; x < scr_cols; x++)
+    if (row[x].ch & 0x80)
+      return 1;
+  return 0;
+}
+
+static void scrHide() {
+  if (hidden)
+    return;
+  scrPut("\x1b[?25l", 6);
+  hidden = 1;
+}
+
+static void scrMove(int y, int x) {
+  char buf[32];
+  int len;
+
+  if (at_y == y && at_x == x)
+    return;
+  if (at_y == y && x == 0)
+    len = snprintf(buf, sizeof(buf), "\r");
+  else if (at_y == y && x > at_x)
+    len = snprintf(buf, sizeof(buf), "\x1b[%dC", x - at_x);
+  else
+    len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y + 1, x + 1);
+  scrPut(buf, len);
+  at_y = y;
+  at_x = x;
+}
+
+/* The SGR parameters for every colour, built the first time a pen is set
+ * so a style change is a few copies rather than a format */
+struct scrSgr {
+  char s[12];
+  int len;
+};
+
+static struct scrSgr sgr_fg[256], sgr_bg[256];
+static int sgr_built = 0;
+
+static void scrSgrBuild() {
+  int i;
+  for (i = 0; i < 256; i++) {
+    sgr_fg[i].len = snprintf(sgr_fg[i].s, sizeof(sgr_fg[i].s), "38;5;%d", i);
+    sgr_bg[i].len = snprintf(sgr_bg[i].s, sizeof(sgr_bg[i].s), "48;5;%d", i);
+  }
+  sgr_built = 1;
+}
+
+static void scrSgrAdd(char *buf, int *len, const char *s, int slen) {
+  if (*len > 2)
+    buf[(*len)++] = ';';
+  memcpy(&buf[*len], s, slen);
+  *len += slen;
+}
+
+/* Change the terminal's style to the cell's, sending only what differs
+ * from the style it has. An attribute can only be turned off by a reset. */
+static void scrPen(struct scrCell *c) {
+  struct scrCell from = {' ', 0, SCR_DEFAULT, SCR_DEFAULT};
+  char buf[48] = "\x1b[";
+  int len = 2;
+
+  if (pen_known && pen.attr == c->attr && pen.fg == c->fg && pen.bg == c->bg)
+    return;
+  if (!sgr_built)
+    scrSgrBuild();
+  if (pen_known && !(pen.attr & ~c->attr))
+    from = pen;
+  else
+    scrSgrAdd(buf, &len, "0", 1);
+
+  if (c->attr & ~from.attr & SCR_REVERSE)
+    scrSgrAdd(buf, &len, "7", 1);
+  if (c->fg != from.fg) {
+    if (c->fg == SCR_DEFAULT)
+      scrSgrAdd(buf, &len, "39", 2);
+    else
+      scrSgrAdd(buf, &len, sgr_fg[c->fg].s, sgr_fg[c->fg].len);
+  }
+  if (c->bg != from.bg) {
+    if (c->bg == SCR_DEFAULT)
+      scrSgrAdd(buf, &len, "49", 2);
+    else
+      scrSgrAdd(buf, &len, sgr_bg[c->bg].s, sgr_bg[c->bg].len);
+  }
+  buf[len++] = 'm';
+  scrPut(buf, len);
+  pen = *c;
+  pen_known = 1;
+}
+
+/* Write cells [from, to) of row y, a run of cells in one style at a time */
+static void scrCells(int y, struct scrCell *row, int from, int to) {
+  int x = from;
+  scrMove(y, from);
+  while (x < to) {
+    struct scrCell *c = &row[x];
+    scrPen(c);
+    scrReserve(to - x);
+    do
+      out[out_len++] = row[x++].ch;
+    while (x < to && row[x].attr == c->attr && row[x].fg == c->fg &&
+           row[x].bg == c->bg);
+  }
+  at_x = to;
+  /* past the last column the cursor waits to wrap */
+  if (at_x >= scr_cols)
+    at_y = -1;
+}
+
+/* Blank row y from column x with an erase, in the style of the cell there */
+static void scrErase(int y, struct scrCell *row, int x) {
+  scrMove(y, x);
+  scrPen(&row[x]);
+  scrPut("\x1b[K", 3);
+}
+
+/* Where the run of plain blanks that ends the row starts */
+static int scrTail(struct scrCell *row) {
+  struct scrCell *last = &row[scr_cols - 1];
+  int x = scr_cols;
+
+  if (scr_cols == 0 || last->ch != ' ' || last->attr)
+    return x;
+  while (x > 0 && scrSame(&row[x - 1], last))
+    x--;
+  return x;
+}
+
+/* Move the rows of the front grid the way the hint says, and the terminal's
+ * with them in a scroll region, if that leaves fewer rows to write. The
+ * rows scrolled in are blanked in the default style. */
+static void scrScroll() {
+  struct scrCell blank = {' ', 0, SCR_DEFAULT, SCR_DEFAULT};
+  int n = scroll_n < 0 ? -scroll_n : scroll_n;
+  int rowsize = sizeof(struct scrCell) * scr_cols;
+  int moved = 0, stayed = 0;
+  int y, x, from;
+  char buf[32];
+  int len;
+
+  if (scroll_top < 0 || scroll_bot > scr_rows || n >= scroll_bot - scroll_top)
+    return;
+  for (y = scroll_top; y < scroll_bot; y++) {
+    from = y + scroll_n;
+    if (from >= scroll_top && from < scroll_bot &&
+        !memcmp(&back[y * scr_cols], &front[from * scr_cols], rowsize))
+      moved++;
+    if (!memcmp(&back[y * scr_cols], &front[y * scr_cols], rowsize))
+      stayed++;
+  }
+  if (moved <= stayed)
+    return;
+
+  scrHide();
+  scrPen(&blank);
+  len = snprintf(buf, sizeof(buf), "\x1b[%d;%dr\x1b[%d%c\x1b[r", scroll_top + 1,
+                 scroll_bot, n, scroll_n > 0 ? 'S' : 'T');
+  scrPut(buf, len);
+  /* setting the region sends the cursor home */
+  at_y = 0;
+  at_x = 0;
+
+  if (scroll_n > 0) {
+    memmove(&front[scroll_top * scr_cols], &front[(scroll_top + n) * scr_cols],
+            rowsize * (scroll_bot - scroll_top - n));
+    from = scroll_bot - n;
+  } else {
+    memmove(&front[(scroll_top + n) * scr_cols], &front[scroll_top * scr_cols],
+            rowsize * (scroll_bot - scroll_top - n));
+    from = scroll_top;
+  }
+  for (y = from; y < from + n; y++)
+    for (x = 0; x < scr_cols; x++)
+      front[y * scr_cols + x] = blank;
+}
+
+/* Write the whole frame, the terminal may take it in pieces. If it
+ * can't be written the terminal is in a state we don't know. */
+static void scrWrite() {
+  long long start = editorPerfNow();
+  int done = 0;
+  editorPerfCount(PERF_BYTES, out_len);
+  if (sink) {
+    sink(out, out_len);
+    out_len = 0;
+    return;
+  }
+  while (done < out_len) {
+    int n = write(STDOUT_FILENO, &out[done], out_len - done);
+    if (n == -1 && errno == EINTR)
+      continue;
+    /* a non-blocking terminal that is full, wait until it drains */
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      struct pollfd pfd = {STDOUT_FILENO, POLLOUT, 0};
+      if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+        editorScreenInvalidate();
+        break;
+      }
+      continue;
+    }
+    if (n <= 0) {
+      editorScreenInvalidate();
+      break;
+    }
+    done += n;
+  }
+  out_len = 0;
+  editorPerfAdd(PERF_WRITE, editorPerfNow() - start);
+}
+
+/* Write out to the terminal what changed since the last frame */
+void editorScreenFlush() {
+  int y, x;
+  int start = 0;
+
+  if (sync_output) {
+    scrPut("\x1b[?2026h", 8);
+    start = out_len;
+  }
+  hidden = 0;
+  if (scroll_n && scr_valid)
+    scrScroll();
+  scroll_n = 0;
+  for (y = 0; y < scr_rows; y++) {
+    struct scrCell *b = &back[y * scr_cols];
+    struct scrCell *f = &front[y * scr_cols];
+    if (scr_valid && !memcmp(b, f, sizeof(struct scrCell) * scr_cols))
+      continue;
+    scrHide();
+    int tail = scrTail(b);
+
+    if (!scr_valid || scrWide(b) || scrWide(f)) {
+      scrCells(y, b, 0, tail);
+      if (tail < scr_cols)
+        scrErase(y, b, tail);
+      if (scrWide(b))
+        at_y = -1;
+      continue;
+    }
+
+    x = 0;
+    while (x < scr_cols) {
+      if (scrSame(&b[x], &f[x])) {
+        x++;
+        continue;
+      }
+      if (x >= tail) {
+        scrErase(y, b, x);
+        break;
+      }
+      int end = x, last = x;
+      while (end < tail && end - last < SCR_JOIN) {
+        if (!scrSame(&b[end], &f[end]))
+          last = end + 1;
+        end++;
+      }
+      scrCells(y, b, x, last);
+      x = last;
+    }
+  }
+
+  if (hidden || at_y != cursor_y || at_x != cursor_x) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", cursor_y + 1,
+                       cursor_x + 1);
+    scrPut(buf, len);
+    at_y = cursor_y;
+    at_x = cursor_x;
+  }
+  if (hidden)
+    scrPut("\x1b[?25h", 6);
+  if (out_len == start)
+    out_len = 0;
+  else if (sync_output)
+    scrPut("\x1b[?2026l", 8);
+
+  struct scrCell *t = front;
+  front = back;
+  back = t;
+  scr_valid = 1;
+  scrWrite();
+}
@@ -0,0 +1,111 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/syntax.h"
+
+/*** filetypes ***/
+
+char *C_HL_extensions[] = {".c", ".h", ".cpp", NULL};
+char *C_HL_keywords[] = {
+    "switch",    "if",    "while",     "for",     "break",   "continue",
+    "return",    "else",  "struct",    "union",   "typedef", "static",
+    "enum",      "class", "case",      "int|",    "long|",   "double|",
+    "float|",    "char|", "unsigned|", "signed|", "void|",   "#define|",
+    "#include|", NULL};
+
+char *GO_HL_extensions[] = {".go", NULL};
+char *GO_HL_keywords[] = {
+    "switch", "if",     "defualt", "for",     "break",   "continue", "return",
+    "else",   "struct", "package", "typedef", "static",  "enum",     "class",
+    "case",   "func",   "var",     "int|",    "string|", "uint|",    "float|",
+    "char|",  "int16|", "int32|",  "int64|",  "import|", NULL};
+
+char *MT_HL_extensions[] = {".MT", ".mt", ".mtl", NULL};
+char *MT_HL_keywords[] = {
+    "if",     "else",   "fn",       "print",   "return",   "class",
+    "this",   "break",  "continue", "switch",  "case",     "default",
+    "super",  "init|",  "len|",     "printf|", "println|", "read|",
+    "write|", "clock|", "use",      "string|", "number|",  "color|",
+    "for",    "while",  "exit|",    "clear|",  "show|",    "Cd|",
+    "Ls|",    "input|", "append|",  "delete|", "var", "let", NULL};
+
+char *RUST_HL_extensions[] = {".rs", ".RS", NULL};
+char* RUST_HL_keywords[] = {
+  // all rust reserved keywords
+  "as", "break", "const", "continue", "crate", 
+  "else", "enum", "extern", "false", "fn", "for", "if", "impl", "in", 
+  "let", "loop", "match", "mod", "move", "mut", "pub", "ref", 
+  "return", "self", "Self", "static", "struct", "super", 
+  "trait", "true", "type", "unsafe", "use", "where", "while", "async", 
+  "await", "dyn", "abstract|", "become|", "box|", "do|", "final|", 
+  "macro|", "override|", "priv|", "typeof|", "unsized|", "virtual|", 
+  "yield|", "try|", "String|", "&str|", "&|", "i8|", "i16|", "i32|",
+  "i64|", "f32|", "f64|", "char|", NULL};
+
+char *PY_HL_extensions[] = {".py", NULL};
+char *PY_HL_keywords[] = {
+    // Python keywords and built-in functions
+    "and", "as", "assert", "break", "class", "continue", "def", "del", "elif",
+    "else", "except", "exec", "finally", "for", "from", "global", "if",
+    "import", "in", "is", "lambda", "not", "or", "pass", "print", "raise",
+    "return", "try", "while", "with", "yield", "async", "await", "nonlocal",
+    "range", "xrange", "reduce", "map", "filter", "all", "any", "sum", "dir",
+    "abs", "breakpoint", "compile", "delattr", "divmod", "format", "eval",
+    "getattr", "hasattr", "hash", "help", "id", "input", "isinstance",
+    "issubclass", "len", "locals", "max", "min", "next", "open", "pow", "repr",
+    "reversed", "round", "setattr", "slice", "sorted", "super", "vars", "zip",
+    "__import__", "reload", "raw_input", "execfile", "file", "cmp",
+    "basestring",
+    // Python types
+    "buffer|", "bytearray|", "bytes|", "complex|", "float|", "frozenset|",
+    "int|", "list|", "long|", "None|", "set|", "str|", "chr|", "tuple|",
+    "bool|", "False|", "True|", "type|", "unicode|", "dict|", "ascii|", "bin|",
+    "callable|", "classmethod|", "enumerate|", "hex|", "oct|", "ord|", "iter|",
+    "memoryview|", "object|", "property|", "staticmethod|", "unichr|", NULL};
+
+char *TEX_HL_extensions[] = {".tex", NULL};
+char *TEX_HL_keywords[] = {
+    "\\usepackage", "\\documentclass", "\\author", "\\title",  "\\centering",
+    "\\maketitle",  "\\begin",         "\\end",    "$$|",      "\\newcommand",
+    "equation|", "equation}|",    "figure|", "figure}|",  "theorem|", "theorem}|", 
+    "tabular|",  "tabular}|", 
+    "document}|", "\\[", "\\]", "&", NULL};
+
+char *MD_HL_extensions[] = {".md", "README", NULL};
+char *MD_HL_keywords[] = {"-", "+", "#", "##", "###", "####", "#####", NULL};
+
+char *JAVA_HL_extensions[] = {".java", NULL};
+char *JAVA_HL_keywords[] = {"_", "abstract", "assert ", "boolean|", "Boolean|", "break",
+  "byte", "case", "catch", "char|", "class", "const", "continue", "default", "do", 
+  "double|", "else", "enum ", "extends", "final", "finally", "float|", "for", "goto", 
+  "if", "implements", "import", "instanceof", "int|", "interface", "long|", "native", 
+  "new", "non-sealed", "package", "private", "protected", "public", "return", "short|",
+  "static", "strictfp", "super", "switch", "String|", "synchronized", "this|", "throw",
+  "throws", "transient", "try", "void|", "volatile", "while", "true|", "false|", "isinstanceof", NULL };
+
+struct editorSyntax HLDB[] = {
+    {"C", C_HL_extensions, C_HL_keywords, "//", "/*", "*/",
+     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC},
+    {"Go", GO_HL_extensions, GO_HL_keywords, "//", "/*", "*/",
+     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC},
+    {"MT", MT_HL_extensions, MT_HL_keywords, "//", "/*", "*/",
+     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC},
+    {"Rust", RUST_HL_extensions, RUST_HL_keywords, "//", "/*", "*/",
+      HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC | HL_HIGHLIGHT_MACROS },
+    {"Python", PY_HL_extensions, PY_HL_keywords, "#", "/*", "*/",
+     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC},
+    {"Java", JAVA_HL_extensions, JAVA_HL_keywords, "//", "/*", "*/",
+      HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_FUNC},
+    {"LaTeX", TEX_HL_extensions, TEX_HL_keywords, "%", "", "",
+     HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_NUMBERS | HL_TEX_ENV},
+    {"Markdown", MD_HL_extensions, MD_HL_keywords, "%", "```",  "```", HL_HIGHLIGHT_NUMBERS | HL_MD_TITLE}};
+
+const unsigned int HLDB_ENTRIES = sizeof(HLDB) / sizeof(HLDB[0]);
+
+/*** highlighting rules ***/
+
+int is_separator(int c) {
+  return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
+}
@@ -1,6 +1,16 @@
 // Copyright (C) 2021 ramsaycarslaw
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
 
 #include "../include/term.h"
+#include "../include/event.h"
+#include "../include/input.h"
+#include "../include/perf.h"
+#include "../include/screen.h"
 
 /*** terminal ***/
 
@@ -15,6 +25,7 @@ void die(const char *s) {
 
 /* Break the terminal out of raw mode */
 void disableRawMode() {
+  write(STDOUT_FILENO, "\x1b[?2004l", 8);
   if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1)
     die("tcsetattr");
 }
@@ -28,56 +39,278 @@ void enableRawMode() {
   raw.c_oflag &= ~(OPOST);
   raw.c_cflag |= (CS8);
   raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+  /* reads never block, the event loop waits for input instead */
   raw.c_cc[VMIN] = 0;
-  raw.c_cc[VTIME] = 1;
+  raw.c_cc[VTIME] = 0;
   if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) die("tcsetattr");
+  /* have pastes marked so they can go in as text rather than keys, and
+   * ask whether frames can be drawn as one update, the answer is picked
+   * up by the input decoder whenever it comes */
+  write(STDOUT_FILENO, "\x1b[?2004h\x1b[?2026$p", 17);
 }
 
 
-int editorReadKey() {
-  int nread;
-  char c;
-  while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
-    if (nread == -1 && errno != EAGAIN) die("read");
+/* Input is read as much as is there at once into input, and decoded from
+ * there into keys. A sequence cut off at the end of what was read waits in
+ * input for the rest of it. */
+static char input[4096];
+static int input_len = 0;
+static int input_pos = 0;
+
+/* Where keys are read from. A file of recorded keys has an end, and the
+ * editor waiting for a key past it is the end of the session. */
+static int input_fd = STDIN_FILENO;
+static int input_recorded = 0;
+
+/* Decoded keys not handed out yet, a ring */
+#define TERM_KEYS 1024
+static int keys[TERM_KEYS];
+static int key_first = 0;
+static int key_count = 0;
+
+/* How long the rest of an escape sequence may take to arrive */
+#define TERM_ESC_MS 100
+
+/* What a sequence that isn't a key decodes to, chars are signed so this
+ * can't be -1 */
+#define TERM_NO_KEY -1000
+#define TERM_PASTE_BEGIN -1001
+
+/* The text of a bracketed paste. pasting is set between its start and end
+ * markers, paste_ready while a PASTE_KEY for it is in the queue. */
+static char *paste = NULL;
+static int paste_len = 0;
+static int paste_cap = 0;
+static int pasting = 0;
+static int paste_ready = 0;
+
+/* Read whatever input there is after what is left in the buffer, waiting
+ * up to ms for it or forever if ms is negative. Returns 0 if none came. */
+static int termFill(int ms) {
+  if (input_pos > 0) {
+    memmove(input, &input[input_pos], input_len - input_pos);
+    input_len -= input_pos;
+    input_pos = 0;
   }
-  if (c == '\x1b') {
-    char seq[3];
-    if (read(STDIN_FILENO, &seq[0], 1) != 1) return '\x1b';
-    if (read(STDIN_FILENO, &seq[1], 1) != 1) return '\x1b';
-    if (seq[0] == '[') {
-      if (seq[1] >= '0' && seq[1] <= '9') {
-        if (read(STDIN_FILENO, &seq[2], 1) != 1) return '\x1b';
-        if (seq[2] == '~') {
-          switch (seq[1]) {
-            case '1': return HOME_KEY;
-    	  case '3': return DEL_KEY;
-            case '4': return END_KEY;
-            case '5': return PAGE_UP;
-            case '6': return PAGE_DOWN;
-            case '7': return HOME_KEY;
-            case '8': return END_KEY;
-          }
-        }
-      } else {
-        switch (seq[1]) {
-          case 'A': return ARROW_UP;
-          case 'B': return ARROW_DOWN;
-          case 'C': return ARROW_RIGHT;
-          case 'D': return ARROW_LEFT;
-          case 'H': return HOME_KEY;
-          case 'F': return END_KEY;
-        }
-      }
-    } else if (seq[0] == 'O') {
-      switch (seq[1]) {
-        case 'H': return HOME_KEY;
-        case 'F': return END_KEY;
+  /* full of one sequence that never ends */
+  if (input_len == sizeof(input))
+    return 0;
+  for (;;) {
+    if (!editorEventWait(input_fd, ms))
+      return 0;
+    int nread = read(input_fd, &input[input_len], sizeof(input) - input_len);
+    if (nread == -1 && errno != EAGAIN && errno != EINTR) die("read");
+    if (nread > 0) {
+      input_len += nread;
+      editorPerfInput();
+      return 1;
+    }
+    if (nread == 0 && input_recorded) {
+      if (ms < 0)
+        exit(0);
+      return 0;
+    }
+    if (ms >= 0)
+      return 0;
+  }
+}
+
+/* The next byte of input as it came, or -1 if none came within ms */
+static int termByte(int ms) {
+  if (input_pos == input_len && !termFill(ms))
+    return -1;
+  return (unsigned char)input[input_pos++];
+}
+
+static int termCsiKey(int final, int param) {
+  switch (final) {
+    case 'A': return ARROW_UP;
+    case 'B': return ARROW_DOWN;
+    case 'C': return ARROW_RIGHT;
+    case 'D': return ARROW_LEFT;
+    case 'H': return HOME_KEY;
+    case 'F': return END_KEY;
+    case '~':
+      switch (param) {
+        case 1: return HOME_KEY;
+        case 3: return DEL_KEY;
+        case 4: return END_KEY;
+        case 5: return PAGE_UP;
+        case 6: return PAGE_DOWN;
+        case 7: return HOME_KEY;
+        case 8: return END_KEY;
+        case 200: return TERM_PASTE_BEGIN;
       }
+  }
+  return TERM_NO_KEY;
+}
+
+/* Decode the key at the start of p. Returns how many bytes it took, or 0
+ * if p ends partway through it. */
+static int termDecodeKey(const char *p, int len, int *key) {
+  int i, param = 0;
+
+  if (p[0] != '\x1b') {
+    *key = p[0];
+    return 1;
+  }
+  if (len < 2)
+    return 0;
+
+  if (p[1] == '[') {
+    /* CSI ? is a reply to a query rather than a key */
+    int reply = len > 2 && p[2] == '?';
+    int second = 0;
+
+    /* the first parameter says which key, the rest (modifiers) are skipped
+     * along with the intermediates up to the final byte */
+    for (i = 2 + reply; i < len && p[i] >= '0' && p[i] <= '9'; i++)
+      if (param < 10000)
+        param = param * 10 + p[i] - '0';
+    if (i < len && p[i] == ';')
+      for (i++; i < len && p[i] >= '0' && p[i] <= '9'; i++)
+        if (second < 10000)
+          second = second * 10 + p[i] - '0';
+    while (i < len && p[i] >= 0x20 && p[i] <= 0x3f)
+      i++;
+    if (i == len)
+      return 0;
+    if (p[i] < 0x40 || p[i] > 0x7e) {
+      *key = '\x1b';
+      return i;
     }
-    return '\x1b';
-  } else {
-    return c;
+    if (reply) {
+      /* DECRPM, 1 to 3 mean synchronized output is there to use */
+      if (p[i] == 'y' && param == 2026 && second >= 1 && second <= 3)
+        editorScreenSync(1);
+      *key = TERM_NO_KEY;
+    } else {
+      *key = termCsiKey(p[i], param);
+    }
+    return i + 1;
   }
+
+  if (p[1] == 'O') {
+    if (len < 3)
+      return 0;
+    *key = termCsiKey(p[2], 0);
+    return 3;
+  }
+
+  /* an escape on its own, what follows is a key of its own too */
+  *key = '\x1b';
+  return 1;
+}
+
+static void termPasteAdd(const char *s, int len) {
+  if (paste_len + len > paste_cap) {
+    paste_cap = paste_cap ? paste_cap : 4096;
+    while (paste_cap < paste_len + len)
+      paste_cap *= 2;
+    paste = realloc(paste, paste_cap);
+    if (paste == NULL)
+      die("realloc");
+  }
+  memcpy(&paste[paste_len], s, len);
+  paste_len += len;
+}
+
+/* Take pasted text up to the end marker. Returns 1 once the paste is
+ * complete, or 0 if the input ran out first. */
+static int termPaste() {
+  const char *p = &input[input_pos];
+  int len = input_len - input_pos;
+  int i;
+
+  for (i = 0; i < len; i++) {
+    if (p[i] != '\x1b')
+      continue;
+    int n = len - i < 6 ? len - i : 6;
+    if (memcmp(&p[i], "\x1b[201~", n))
+      continue;
+    /* the marker may be cut off, leave it for the rest to arrive */
+    if (n < 6)
+      break;
+    termPasteAdd(p, i);
+    input_pos += i + 6;
+    pasting = 0;
+    paste_ready = 1;
+    keys[(key_first + key_count++) % TERM_KEYS] = PASTE_KEY;
+    return 1;
+  }
+  termPasteAdd(p, i);
+  input_pos += i;
+  return 0;
+}
+
+/* Turn as much of the input as possible into keys */
+static void termDecode() {
+  while (input_pos < input_len && key_count < TERM_KEYS) {
+    if (pasting) {
+      if (!termPaste())
+        break;
+      continue;
+    }
+
+    int key;
+    int n = termDecodeKey(&input[input_pos], input_len - input_pos, &key);
+    if (n == 0)
+      break;
+    if (key == TERM_PASTE_BEGIN) {
+      /* one paste at a time, the next waits until this one is taken */
+      if (paste_ready)
+        break;
+      pasting = 1;
+      paste_len = 0;
+      input_pos += n;
+      continue;
+    }
+    input_pos += n;
+    if (key != TERM_NO_KEY)
+      keys[(key_first + key_count++) % TERM_KEYS] = key;
+  }
+}
+
+/* The text of the paste a PASTE_KEY was for */
+char *editorPasteText(int *len) {
+  paste_ready = 0;
+  *len = paste_len;
+  return paste;
+}
+
+/* Whether a key can be had without waiting. Takes in any input that has
+ * arrived so a whole paste is handled before the screen is drawn. */
+int editorKeyPending() {
+  if (key_count == 0 && termFill(0))
+    termDecode();
+  return key_count > 0;
+}
+
+int editorReadKey() {
+  long long start = editorPerfNow();
+  while (key_count == 0) {
+    if (input_pos == input_len || pasting) {
+      termFill(-1);
+    } else if (!termFill(TERM_ESC_MS)) {
+      /* the rest of the sequence never came, take it as an escape */
+      input_pos = input_len;
+      keys[key_first] = '\x1b';
+      key_count = 1;
+    }
+    termDecode();
+  }
+
+  int key = keys[key_first];
+  key_first = (key_first + 1) % TERM_KEYS;
+  key_count--;
+  editorPerfWait(editorPerfNow() - start);
+  return key;
+}
+
+/* Read keys from a file of recorded input instead of the terminal */
+void editorInputFrom(int fd) {
+  input_fd = fd;
+  input_recorded = 1;
 }
 
 /* Returns the coordinates of the cursor */
@@ -85,8 +318,10 @@ int getCursorPosition(int *rows, int *cols) {
   char buf[32];
   unsigned int i = 0;
   if (write(STDOUT_FILENO, "\x1b[6n", 4) != 4) return -1;
+  int c;
   while (i < sizeof(buf) - 1) {
-    if (read(STDIN_FILENO, &buf[i], 1) != 1) break;
+    if ((c = termByte(TERM_ESC_MS)) == -1) break;
+    buf[i] = c;
     if (buf[i] == 'R') break;
     i++;
   }
@@ -97,9 +332,23 @@ int getCursorPosition(int *rows, int *cols) {
 }
 
 
+/* A size given up front, for running without a terminal */
+static int fixed_rows = 0;
+static int fixed_cols = 0;
+
+void editorFixSize(int rows, int cols) {
+  fixed_rows = rows;
+  fixed_cols = cols;
+}
+
 /* Returns the size of the current termibal window */  
 int getWindowSize(int *rows, int *cols) {
   struct winsize ws;
+  if (fixed_rows) {
+    *rows = fixed_rows;
+    *cols = fixed_cols;
+    return 0;
+  }
   if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0) {
     if (write(STDOUT_FILENO, "\x1b[999C\x1b[999B", 12) != 12) return -1;
     return getCursorPosition(rows, cols);
@@ -110,3 +359,55 @@ int getWindowSize(int *rows, int *cols) {
   }
 }
 
+/* SIGWINCH only writes to this pipe, the resize itself happens in the
+ * event loop */
+static int winch[2] = {-1, -1};
+
+/* How long the size has to stay put before the editor is laid out again,
+ * so dragging a window redraws once rather than for every step */
+#define TERM_RESIZE_MS 30
+
+static void termWinch(int sig) {
+  int saved = errno;
+  (void)sig;
+  write(winch[1], "", 1);
+  errno = saved;
+}
+
+static void termResize() {
+  int rows, cols;
+  if (getWindowSize(&rows, &cols) == -1)
+    return;
+  if (rows == E.raw_screenrows && cols == E.raw_screencols)
+    return;
+  E.raw_screenrows = rows;
+  E.raw_screencols = cols;
+  E.screenrows = E.raw_screenrows - 2;
+  /* the terminal may have moved or reflowed what it showed */
+  editorScreenInvalidate();
+  editorRefreshScreen();
+}
+
+static void termWinchReady(int fd) {
+  char buf[64];
+  while (read(fd, buf, sizeof(buf)) > 0)
+    ;
+  editorEventTimer(TERM_RESIZE_MS, termResize);
+}
+
+/* Follow the size of the terminal as it changes */
+void editorWatchResize() {
+  struct sigaction sa;
+
+  if (pipe(winch) == -1)
+    die("pipe");
+  fcntl(winch[0], F_SETFL, O_NONBLOCK);
+  fcntl(winch[1], F_SETFL, O_NONBLOCK);
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = termWinch;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  if (sigaction(SIGWINCH, &sa, NULL) == -1)
+    die("sigaction");
+  editorEventWatch(winch[0], termWinchReady);
+}
@@ -0,0 +1,106 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/perf.h"
+#include "../include/term.h"
+#include "../include/trace.h"
+
+/*** trace ***/
+
+/* Events kept per thread, older ones are written over */
+#define TRACE_RING 65536
+
+struct traceEvent {
+  const char *name;
+  long long start, dur;
+};
+
+/* Only its own thread writes to a ring. head counts every event written
+ * and is published after the event, so the flush at exit reads whole
+ * events. */
+struct traceRing {
+  struct traceEvent ev[TRACE_RING];
+  unsigned long long head;
+  int tid;
+  struct traceRing *next;
+};
+
+static const char *trace_path = NULL;
+static long long trace_start = 0;
+static struct traceRing *rings = NULL;
+static int nrings = 0;
+static __thread struct traceRing *mine = NULL;
+
+/* The calling thread's ring, made on its first event */
+static struct traceRing *traceRing() {
+  if (mine)
+    return mine;
+  struct traceRing *r = calloc(1, sizeof(*r));
+  if (r == NULL)
+    die("calloc");
+  r->tid = __atomic_add_fetch(&nrings, 1, __ATOMIC_RELAXED);
+  r->next = __atomic_load_n(&rings, __ATOMIC_ACQUIRE);
+  while (!__atomic_compare_exchange_n(&rings, &r->next, r, 0, __ATOMIC_RELEASE,
+                                      __ATOMIC_ACQUIRE))
+    ;
+  mine = r;
+  return r;
+}
+
+static void traceFlush() {
+  FILE *f = fopen(trace_path, "w");
+  struct traceRing *r;
+
+  if (f == NULL) {
+    perror(trace_path);
+    return;
+  }
+  fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+             "\"args\": {\"name\": \"charm\"}}");
+  for (r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+    unsigned long long head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    unsigned long long i = head > TRACE_RING ? head - TRACE_RING : 0;
+
+    fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+               "\"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+            r->tid, r->tid == 1 ? "main" : "worker", r->tid);
+    for (; i < head; i++) {
+      struct traceEvent *e = &r->ev[i % TRACE_RING];
+      fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                 "\"ts\": %.3f, \"dur\": %.3f}",
+              e->name, r->tid, (e->start - trace_start) / 1e3, e->dur / 1e3);
+    }
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+}
+
+/* Record spans from now on and write them to path at exit */
+void editorTraceStart(const char *path) {
+  trace_path = path;
+  trace_start = editorPerfNow();
+  /* the main thread's ring comes first so it is tid 1 */
+  traceRing();
+  atexit(traceFlush);
+}
+
+/* The start of a span, 0 when not tracing */
+long long editorTraceBegin() {
+  return trace_path ? editorPerfNow() : 0;
+}
+
+void editorTraceEnd(const char *name, long long start) {
+  if (start == 0)
+    return;
+  struct traceRing *r = traceRing();
+  struct traceEvent *e = &r->ev[r->head % TRACE_RING];
+  e->name = name;
+  e->start = start;
+  e->dur = editorPerfNow() - start;
+  __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
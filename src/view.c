@@ -0,0 +1,236 @@
+// Copyright (C) 2021 Ramsay Carslaw
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/rows.h"
+#include "../include/term.h"
+#include "../include/trace.h"
+#include "../include/view.h"
+
+/*** lazy rendering ***/
+
+/* Every row with a render lies in [mat_first, mat_last) */
+static int mat_first = 0;
+static int mat_last = 0;
+
+/* hl_open_comment is right for every row above hl_valid. Rows above
+ * hl_known have a state from an earlier pass, which is still right unless
+ * the row is on the dirty list or the row before it came out differently
+ * this time round. */
+static int hl_valid = 0;
+static int hl_known = 0;
+
+/* Rows in [hl_valid, hl_known) whose text changed, in order */
+static int *dirty = NULL;
+static int ndirty = 0;
+static int dirty_cap = 0;
+
+/* Past this many edits it is cheaper to forget the old states */
+#define VIEW_MAX_DIRTY 1024
+
+static void viewEvict(erow *row) {
+  free(row->render);
+  free(row->hl);
+  row->render = NULL;
+  row->hl = NULL;
+  row->rsize = 0;
+}
+
+/* Where 'at' is, or would go, in the dirty list */
+static int viewDirtyIndex(int at) {
+  int lo = 0, hi = ndirty;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (dirty[mid] < at)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void viewMarkDirty(int at) {
+  if (at >= hl_known)
+    return;
+  int i = viewDirtyIndex(at);
+  if (i < ndirty && dirty[i] == at)
+    return;
+
+  if (ndirty == VIEW_MAX_DIRTY) {
+    hl_known = dirty[0] < at ? dirty[0] : at;
+    ndirty = 0;
+    return;
+  }
+  if (ndirty == dirty_cap) {
+    dirty_cap = dirty_cap ? dirty_cap * 2 : 16;
+    dirty = realloc(dirty, sizeof(int) * dirty_cap);
+    if (dirty == NULL)
+      die("realloc");
+  }
+  memmove(&dirty[i + 1], &dirty[i], sizeof(int) * (ndirty - i));
+  dirty[i] = at;
+  ndirty++;
+}
+
+/* Move the dirty rows from 'at' on by delta */
+static void viewShiftDirty(int at, int delta) {
+  int i;
+  for (i = viewDirtyIndex(at); i < ndirty; i++)
+    dirty[i] += delta;
+}
+
+/* Lex rows in order until the state of every row above 'to' is right. A
+ * row that ends in the same state as last time means the rows after it
+ * are still right up to the next dirty one, so skip straight there. */
+static void viewAdvance(int to) {
+  int state = hl_valid > 0 ? editorRowAt(hl_valid - 1)->hl_open_comment : 0;
+
+  if (to > E.numrows)
+    to = E.numrows;
+  while (hl_valid < to) {
+    int at = hl_valid;
+    erow *row = editorRowAt(at);
+    int old = row->hl_open_comment;
+
+    if (row->render)
+      state = editorSyntaxLex(row, state);
+    else
+      state = editorSyntaxState(row, state);
+    row->hl_open_comment = state;
+    hl_valid++;
+    if (ndirty && dirty[0] == at) {
+      ndirty--;
+      memmove(&dirty[0], &dirty[1], sizeof(int) * ndirty);
+    }
+
+    if (at < hl_known && state == old) {
+      int next = ndirty ? dirty[0] : hl_known;
+      if (next > hl_valid) {
+        hl_valid = next;
+        state = editorRowAt(hl_valid - 1)->hl_open_comment;
+      }
+    }
+    if (hl_valid > hl_known)
+      hl_known = hl_valid;
+  }
+}
+
+/* Make sure rows [first, last) have an up to date render and hl and let
+ * go of those belonging to rows outside it */
+void editorViewPrepare(int first, int last) {
+  long long span = editorTraceBegin();
+  int at;
+
+  if (first < 0)
+    first = 0;
+  if (last > E.numrows)
+    last = E.numrows;
+  if (last < first)
+    last = first;
+
+  for (at = mat_first; at < mat_last && at < E.numrows; at++) {
+    if (at >= first && at < last)
+      continue;
+    erow *row = editorRowAt(at);
+    if (row->render)
+      viewEvict(row);
+  }
+  mat_first = first;
+  mat_last = last;
+
+  viewAdvance(last);
+
+  for (at = first; at < last; at++) {
+    erow *row = editorRowAt(at);
+    if (row->render)
+      continue;
+    editorRenderRow(row, 0);
+    editorSyntaxLex(row, at > 0 ? editorRowAt(at - 1)->hl_open_comment : 0);
+  }
+  editorTraceEnd("highlight", span);
+}
+
+/* Carry line states further down the file while nothing else is going
+ * on. Returns whether there is more to do. */
+int editorViewIdle() {
+  long long span = editorTraceBegin();
+  struct timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (hl_valid < E.numrows) {
+    viewAdvance(hl_valid + 4096);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ((now.tv_sec - start.tv_sec) * 1000 +
+            (now.tv_nsec - start.tv_nsec) / 1000000 >=
+        VIEW_SLICE_MS)
+      break;
+  }
+  editorTraceEnd("highlight idle", span);
+  return hl_valid < E.numrows;
+}
+
+/* A row was inserted at 'at' */
+void editorViewInsert(int at) {
+  if (at <= mat_first) {
+    mat_first++;
+    mat_last++;
+  } else if (at < mat_last) {
+    mat_last++;
+  }
+  if (at < hl_valid)
+    hl_valid = at;
+  if (at < hl_known) {
+    viewShiftDirty(at, 1);
+    hl_known++;
+    /* the row after it was lexed following the state of the row before */
+    editorRowAt(at)->hl_open_comment =
+        at > 0 ? editorRowAt(at - 1)->hl_open_comment : 0;
+    viewMarkDirty(at);
+  }
+}
+
+/* A row was deleted from 'at' */
+void editorViewDelete(int at) {
+  if (at < mat_first) {
+    mat_first--;
+    mat_last--;
+  } else if (at < mat_last) {
+    mat_last--;
+  }
+  if (at < hl_valid)
+    hl_valid = at;
+  if (at < hl_known) {
+    int i = viewDirtyIndex(at);
+    if (i < ndirty && dirty[i] == at) {
+      ndirty--;
+      memmove(&dirty[i], &dirty[i + 1], sizeof(int) * (ndirty - i));
+    }
+    viewShiftDirty(at, -1);
+    hl_known--;
+    /* the row that moved up now follows a different row */
+    viewMarkDirty(at);
+  }
+}
+
+/* The text of row 'at' changed */
+void editorViewInvalidate(int at) {
+  if (at < hl_valid)
+    hl_valid = at;
+  viewMarkDirty(at);
+}
+
+/* Forget every line state and render, for when the syntax changes */
+void editorViewReset() {
+  int at;
+  for (at = mat_first; at < mat_last && at < E.numrows; at++) {
+    erow *row = editorRowAt(at);
+    if (row->render)
+      viewEvict(row);
+  }
+  hl_valid = 0;
+  hl_known = 0;
+  ndirty = 0;
+}
@@ -0,0 +1,54 @@
+// Copyright (C) 2021 Ramsay Carslaw
+/* A malloc that counts the allocations each thread makes, for test/test:
+ *
+ *   LD_PRELOAD=test/alloc.so charm --headless --json --keys keys file
+ *
+ * gives charm editorAllocCount, so the replay reports the allocations the
+ * keys made as "allocs" and how many keys made any as "alloc_keys", and
+ * :perf shows them per frame. Only glibc has the __libc_ entry points this
+ * hands the allocations on to. */
+#define _GNU_SOURCE
+#include <stddef.h>
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t align, size_t size);
+
+static __thread long long allocs __attribute__((tls_model("initial-exec")));
+
+void *malloc(size_t size) {
+  allocs++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+  allocs++;
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) {
+  allocs++;
+  return __libc_realloc(p, size);
+}
+
+int posix_memalign(void **p, size_t align, size_t size) {
+  allocs++;
+  *p = __libc_memalign(align, size);
+  return *p ? 0 : 12; /* ENOMEM */
+}
+
+void *aligned_alloc(size_t align, size_t size) {
+  allocs++;
+  return __libc_memalign(align, size);
+}
+
+void *memalign(size_t align, size_t size) {
+  allocs++;
+  return __libc_memalign(align, size);
+}
+
+/* Allocations made so far by the calling thread */
+long long editorAllocCount() {
+  return allocs;
+}